@@ -0,0 +1,794 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "layering.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace {
+
+constexpr uint32_t None = UINT32_MAX;
+
+// The network simplex over the constraint graph rank[head] - rank[tail] >= 1.
+// The spanning tree of every weakly connected component is kept with the
+// postorder numbers of its nodes: the subtree of v is the nodes with lim in
+// [low(v), lim(v)], which are stored contiguously in the postorder array.
+class NetworkSimplex {
+  const size_t nodeCount;
+  std::vector<NodeId> tails;
+  std::vector<NodeId> heads;
+  // The incident edges of the nodes in the compressed sparse row format
+  std::vector<uint32_t> outOffsets;
+  std::vector<uint32_t> outEdges;
+  std::vector<uint32_t> inOffsets;
+  std::vector<uint32_t> inEdges;
+
+  std::vector<int> ranks;
+  std::vector<uint8_t> inTree;
+  std::vector<int> cutValues;
+  std::vector<uint32_t> treeEdges;
+  std::vector<uint32_t> treeEdgeIndices;
+  size_t searchStart = 0;
+
+  std::vector<uint32_t> parents;
+  std::vector<uint32_t> lows;
+  std::vector<uint32_t> lims;
+  std::vector<NodeId> postorder;
+  std::vector<uint32_t> components;
+  std::vector<NodeId> roots;
+  std::vector<std::pair<NodeId, uint32_t>> resized;
+  std::vector<NodeId> rerootPath;
+  std::vector<std::pair<NodeId, uint32_t>> rerooted;
+  std::vector<std::pair<NodeId, uint32_t>> path;
+
+public:
+  NetworkSimplex(const Adjacency &succ, const std::vector<bool> &deletedEdges);
+
+  // Longest path ranking, the nodes are returned in a topological order
+  std::vector<NodeId> initRanks();
+  void buildFeasibleTree();
+  size_t optimize(size_t maxIterations);
+  void normalize();
+
+  int getRank(NodeId id) const {
+    return ranks[id];
+  }
+
+  // The total slack of the edges, i.e. the number of the dummy nodes
+  size_t getDummyCount() const;
+
+private:
+  int getSlack(uint32_t e) const {
+    return ranks[heads[e]] - ranks[tails[e]] - 1;
+  }
+
+  bool isInSubtree(NodeId root, NodeId id) const {
+    return lows[root] <= lims[id] && lims[id] <= lims[root];
+  }
+
+  uint32_t setRanges(NodeId root, uint32_t parentEdge, uint32_t low);
+
+  NodeId getParentNode(NodeId id) const {
+    const uint32_t e = parents[id];
+    return tails[e] == id ? heads[e] : tails[e];
+  }
+
+  void moveNode(NodeId id, uint32_t lim) {
+    lows[id] = lows[id] + lim - lims[id];
+    lims[id] = lim;
+    postorder[lim] = id;
+  }
+
+  void initCutValues();
+  int getCutValueTerm(uint32_t e, NodeId id, int direction) const;
+  void setCutValue(uint32_t e);
+  uint32_t leaveEdge();
+  uint32_t enterEdge(uint32_t e) const;
+  void shiftSubtree(NodeId id, int delta);
+  NodeId updateCutValues(NodeId v, NodeId w, int cutValue, bool direction);
+  void exchange(uint32_t e, uint32_t f);
+  void rerootSubtree(NodeId id, NodeId root, uint32_t parentEdge);
+};
+
+void fillIncidence(
+    size_t nodeCount,
+    const std::vector<NodeId> &ends,
+    std::vector<uint32_t> &offsets,
+    std::vector<uint32_t> &edges) {
+  offsets.assign(nodeCount + 1, 0);
+  for (NodeId id : ends) {
+    offsets[id + 1]++;
+  }
+  for (size_t i = 0; i < nodeCount; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+  std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+  edges.resize(ends.size());
+  for (uint32_t e = 0; e < ends.size(); e++) {
+    edges[filled[ends[e]]++] = e;
+  }
+}
+
+NetworkSimplex::NetworkSimplex(
+    const Adjacency &succ, const std::vector<bool> &deletedEdges)
+    : nodeCount(succ.getNodeCount()) {
+  for (NodeId i = 0; i < nodeCount; i++) {
+    for (size_t e = succ.offsets[i]; e < succ.offsets[i + 1]; e++) {
+      const NodeId succId = succ.ids[e];
+      if (succId == i) {
+        continue;
+      }
+      tails.push_back(deletedEdges[e] ? succId : i);
+      heads.push_back(deletedEdges[e] ? i : succId);
+    }
+  }
+  fillIncidence(nodeCount, tails, outOffsets, outEdges);
+  fillIncidence(nodeCount, heads, inOffsets, inEdges);
+
+  ranks.assign(nodeCount, 0);
+  inTree.assign(tails.size(), false);
+  cutValues.assign(tails.size(), 0);
+  treeEdgeIndices.assign(tails.size(), None);
+  parents.assign(nodeCount, None);
+  lows.assign(nodeCount, 0);
+  lims.assign(nodeCount, 0);
+  postorder.assign(nodeCount, 0);
+  components.assign(nodeCount, None);
+}
+
+std::vector<NodeId> NetworkSimplex::initRanks() {
+  std::vector<uint32_t> degrees(nodeCount);
+  std::vector<NodeId> worklist;
+  worklist.reserve(nodeCount);
+  for (NodeId i = 0; i < nodeCount; i++) {
+    degrees[i] = inOffsets[i + 1] - inOffsets[i];
+    if (degrees[i] == 0) {
+      worklist.push_back(i);
+    }
+  }
+  for (size_t k = 0; k < worklist.size(); k++) {
+    const NodeId id = worklist[k];
+    for (uint32_t i = outOffsets[id]; i < outOffsets[id + 1]; i++) {
+      const NodeId head = heads[outEdges[i]];
+      ranks[head] = std::max(ranks[head], ranks[id] + 1);
+      if (--degrees[head] == 0) {
+        worklist.push_back(head);
+      }
+    }
+  }
+  assert(worklist.size() == nodeCount && "the constraints must be acyclic");
+  return worklist;
+}
+
+// Growing the tight trees: the smallest tree is shifted to make its incident
+// edge of the minimum slack tight and merged with the tree at the other end.
+// Taking the smallest tree first, every node is scanned O(log V) times.
+void NetworkSimplex::buildFeasibleTree() {
+  std::vector<uint32_t> sets(nodeCount);
+  std::vector<uint32_t> sizes(nodeCount, 1);
+  std::vector<NodeId> firsts(nodeCount);
+  std::vector<NodeId> lasts(nodeCount);
+  std::vector<NodeId> nexts(nodeCount, None);
+  for (NodeId i = 0; i < nodeCount; i++) {
+    sets[i] = firsts[i] = lasts[i] = i;
+  }
+
+  auto find = [&](NodeId id) {
+    while (sets[id] != id) {
+      id = sets[id] = sets[sets[id]];
+    }
+    return id;
+  };
+  auto unite = [&](uint32_t a, uint32_t b) {
+    if (sizes[a] < sizes[b]) {
+      std::swap(a, b);
+    }
+    sets[b] = a;
+    sizes[a] += sizes[b];
+    nexts[lasts[a]] = firsts[b];
+    lasts[a] = lasts[b];
+    return a;
+  };
+  auto addTreeEdge = [&](uint32_t e) {
+    inTree[e] = true;
+    treeEdgeIndices[e] = treeEdges.size();
+    treeEdges.push_back(e);
+  };
+
+  for (uint32_t e = 0; e < tails.size(); e++) {
+    const uint32_t a = find(tails[e]), b = find(heads[e]);
+    if (a != b && getSlack(e) == 0) {
+      unite(a, b);
+      addTreeEdge(e);
+    }
+  }
+
+  using Tree = std::pair<uint32_t, uint32_t>;
+  std::priority_queue<Tree, std::vector<Tree>, std::greater<Tree>> trees;
+  for (NodeId i = 0; i < nodeCount; i++) {
+    if (find(i) == i) {
+      trees.emplace(sizes[i], i);
+    }
+  }
+
+  while (!trees.empty()) {
+    const auto [size, tree] = trees.top();
+    trees.pop();
+    if (sets[tree] != tree || sizes[tree] != size) {
+      continue;
+    }
+
+    uint32_t best = None;
+    int bestSlack = INT_MAX;
+    int delta = 0;
+    for (NodeId id = firsts[tree]; id != None; id = nexts[id]) {
+      for (uint32_t i = outOffsets[id]; i < outOffsets[id + 1]; i++) {
+        const uint32_t e = outEdges[i];
+        if (getSlack(e) < bestSlack && find(heads[e]) != tree) {
+          best = e;
+          bestSlack = getSlack(e);
+          delta = bestSlack;
+        }
+      }
+      for (uint32_t i = inOffsets[id]; i < inOffsets[id + 1]; i++) {
+        const uint32_t e = inEdges[i];
+        if (getSlack(e) < bestSlack && find(tails[e]) != tree) {
+          best = e;
+          bestSlack = getSlack(e);
+          delta = -bestSlack;
+        }
+      }
+    }
+    if (best == None) {
+      // The tree spans a whole weakly connected component
+      continue;
+    }
+
+    for (NodeId id = firsts[tree]; id != None; id = nexts[id]) {
+      ranks[id] += delta;
+    }
+    addTreeEdge(best);
+    const uint32_t merged = unite(find(tails[best]), find(heads[best]));
+    trees.emplace(sizes[merged], merged);
+  }
+
+  uint32_t low = 0;
+  for (NodeId i = 0; i < nodeCount; i++) {
+    if (components[i] == None) {
+      const uint32_t component = roots.size();
+      roots.push_back(i);
+      const uint32_t end = setRanges(i, None, low);
+      for (uint32_t k = low; k < end; k++) {
+        components[postorder[k]] = component;
+      }
+      low = end;
+    }
+  }
+  initCutValues();
+}
+
+// Numbering the subtree of the root in the postorder starting from low,
+// the number after the last one is returned
+uint32_t NetworkSimplex::setRanges(
+    NodeId root, uint32_t parentEdge, uint32_t low) {
+  path.clear();
+  parents[root] = parentEdge;
+  lows[root] = low;
+  path.emplace_back(root, 0);
+
+  uint32_t next = low;
+  while (!path.empty()) {
+    const NodeId id = path.back().first;
+    const uint32_t outCount = outOffsets[id + 1] - outOffsets[id];
+    const uint32_t count = outCount + inOffsets[id + 1] - inOffsets[id];
+
+    NodeId child = None;
+    uint32_t &k = path.back().second;
+    while (k < count && child == None) {
+      const bool isOut = k < outCount;
+      const uint32_t e = isOut ? outEdges[outOffsets[id] + k]
+                               : inEdges[inOffsets[id] + k - outCount];
+      k++;
+      if (inTree[e] && e != parents[id]) {
+        child = isOut ? heads[e] : tails[e];
+        parents[child] = e;
+        lows[child] = next;
+      }
+    }
+
+    if (child != None) {
+      path.emplace_back(child, 0);
+    } else {
+      lims[id] = next;
+      postorder[next++] = id;
+      path.pop_back();
+    }
+  }
+  return next;
+}
+
+// The cut value of a tree edge is the weight of the edges going from the
+// tail component to the head one minus the weight of the opposite edges.
+// It is computed from the cut values of the child edges in the postorder.
+void NetworkSimplex::initCutValues() {
+  for (NodeId id : postorder) {
+    if (parents[id] != None) {
+      setCutValue(parents[id]);
+    }
+  }
+}
+
+int NetworkSimplex::getCutValueTerm(
+    uint32_t e, NodeId id, int direction) const {
+  const NodeId other = tails[e] == id ? heads[e] : tails[e];
+  const bool isOutside = !isInSubtree(id, other);
+
+  int value;
+  if (isOutside) {
+    value = 1;
+  } else {
+    value = (inTree[e] ? cutValues[e] : 0) - 1;
+  }
+
+  int sign;
+  if (direction > 0) {
+    sign = heads[e] == id ? 1 : -1;
+  } else {
+    sign = tails[e] == id ? 1 : -1;
+  }
+  if (isOutside) {
+    sign = -sign;
+  }
+  return sign < 0 ? -value : value;
+}
+
+void NetworkSimplex::setCutValue(uint32_t f) {
+  NodeId id;
+  int direction;
+  if (parents[tails[f]] == f) {
+    id = tails[f];
+    direction = 1;
+  } else {
+    id = heads[f];
+    direction = -1;
+  }
+
+  int sum = 0;
+  for (uint32_t i = outOffsets[id]; i < outOffsets[id + 1]; i++) {
+    sum += getCutValueTerm(outEdges[i], id, direction);
+  }
+  for (uint32_t i = inOffsets[id]; i < inOffsets[id + 1]; i++) {
+    sum += getCutValueTerm(inEdges[i], id, direction);
+  }
+  cutValues[f] = sum;
+}
+
+// A tree edge with a negative cut value: the most negative of the first few
+// ones found, the search continues from the place where it stopped
+uint32_t NetworkSimplex::leaveEdge() {
+  constexpr size_t SearchSize = 30;
+
+  uint32_t result = None;
+  size_t found = 0;
+  for (size_t k = 0; k < treeEdges.size(); k++) {
+    const size_t i = (searchStart + k) % treeEdges.size();
+    const uint32_t e = treeEdges[i];
+    if (cutValues[e] >= 0) {
+      continue;
+    }
+    if (result == None || cutValues[e] < cutValues[result]) {
+      result = e;
+    }
+    if (++found == SearchSize) {
+      searchStart = i;
+      return result;
+    }
+  }
+  searchStart = 0;
+  return result;
+}
+
+// The non-tree edge of the minimum slack crossing the cut of the tree edge in
+// the opposite direction. The subtree is scanned from its root, so the ties
+// are broken near the previous pivots instead of at the same hanging subtrees
+// over and over, which makes the degenerate pivots converge much faster
+uint32_t NetworkSimplex::enterEdge(uint32_t e) const {
+  const bool isTailBelow = lims[tails[e]] < lims[heads[e]];
+  const NodeId root = isTailBelow ? tails[e] : heads[e];
+
+  uint32_t result = None;
+  int resultSlack = INT_MAX;
+  for (uint32_t k = lims[root] + 1; k-- > lows[root] && resultSlack > 0;) {
+    const NodeId id = postorder[k];
+    if (isTailBelow) {
+      for (uint32_t i = inOffsets[id]; i < inOffsets[id + 1]; i++) {
+        const uint32_t f = inEdges[i];
+        if (!inTree[f] && !isInSubtree(root, tails[f]) &&
+            getSlack(f) < resultSlack) {
+          result = f;
+          resultSlack = getSlack(f);
+        }
+      }
+    } else {
+      for (uint32_t i = outOffsets[id]; i < outOffsets[id + 1]; i++) {
+        const uint32_t f = outEdges[i];
+        if (!inTree[f] && !isInSubtree(root, heads[f]) &&
+            getSlack(f) < resultSlack) {
+          result = f;
+          resultSlack = getSlack(f);
+        }
+      }
+    }
+  }
+  return result;
+}
+
+// Adding delta to the ranks of the subtree of the node, the rest of the tree
+// is shifted the other way if it is smaller
+void NetworkSimplex::shiftSubtree(NodeId id, int delta) {
+  const NodeId root = roots[components[id]];
+  const uint32_t size = lims[id] - lows[id] + 1;
+  const uint32_t treeSize = lims[root] - lows[root] + 1;
+  if (2 * size <= treeSize) {
+    for (uint32_t k = lows[id]; k <= lims[id]; k++) {
+      ranks[postorder[k]] += delta;
+    }
+    return;
+  }
+  for (uint32_t k = lows[root]; k <= lims[root]; k++) {
+    if (k < lows[id] || k > lims[id]) {
+      ranks[postorder[k]] -= delta;
+    }
+  }
+}
+
+// Correcting the cut values on the tree path from v to the common ancestor
+// with w, the ancestor is returned
+NodeId NetworkSimplex::updateCutValues(
+    NodeId v, NodeId w, int cutValue, bool direction) {
+  while (!isInSubtree(v, w)) {
+    const uint32_t e = parents[v];
+    const bool isForward = v == tails[e] ? direction : !direction;
+    cutValues[e] += isForward ? cutValue : -cutValue;
+    v = lims[tails[e]] > lims[heads[e]] ? tails[e] : heads[e];
+  }
+  return v;
+}
+
+// Replacing the tree edge e by the non-tree edge f. The subtree below e is
+// rerooted at the end of f and moved right before the other end of f in the
+// postorder, so only the nodes in between and on the tree paths to the common
+// ancestor are renumbered.
+void NetworkSimplex::exchange(uint32_t e, uint32_t f) {
+  const bool isTailBelow = lims[tails[e]] < lims[heads[e]];
+  const NodeId child = isTailBelow ? tails[e] : heads[e];
+  const NodeId parent = isTailBelow ? heads[e] : tails[e];
+  const bool isTailInside = isInSubtree(child, tails[f]);
+  const NodeId inside = isTailInside ? tails[f] : heads[f];
+  const NodeId outside = isTailInside ? heads[f] : tails[f];
+
+  const int delta = getSlack(f);
+  if (delta > 0) {
+    shiftSubtree(child, isTailBelow ? -delta : delta);
+  }
+
+  const int cutValue = cutValues[e];
+  const NodeId ancestor = updateCutValues(tails[f], heads[f], cutValue, true);
+  [[maybe_unused]] const NodeId other =
+      updateCutValues(heads[f], tails[f], cutValue, false);
+  assert(ancestor == other);
+  cutValues[f] = -cutValue;
+  cutValues[e] = 0;
+
+  inTree[e] = false;
+  inTree[f] = true;
+  treeEdgeIndices[f] = treeEdgeIndices[e];
+  treeEdges[treeEdgeIndices[f]] = f;
+  treeEdgeIndices[e] = None;
+
+  // The subtree sizes change on the paths from both ends to the ancestor
+  const uint32_t size = lims[child] - lows[child] + 1;
+  resized.clear();
+  for (NodeId v = parent; v != ancestor; v = getParentNode(v)) {
+    resized.emplace_back(v, lims[v] - lows[v] + 1 - size);
+  }
+  for (NodeId v = outside; v != ancestor; v = getParentNode(v)) {
+    resized.emplace_back(v, lims[v] - lows[v] + 1 + size);
+  }
+
+  const uint32_t childLow = lows[child];
+  const uint32_t childLim = lims[child];
+  rerootSubtree(inside, child, f);
+
+  uint32_t start;
+  if (lims[outside] > childLim) {
+    for (uint32_t k = childLim + 1; k < lims[outside]; k++) {
+      moveNode(postorder[k], k - size);
+    }
+    start = lims[outside] - size;
+  } else {
+    start = lims[outside];
+    for (uint32_t k = childLow; k-- > start;) {
+      moveNode(postorder[k], k + size);
+    }
+  }
+  for (uint32_t k = 0; k < size; k++) {
+    const NodeId id = rerooted[k].first;
+    postorder[start + k] = id;
+    lims[id] = start + k;
+    lows[id] = start + rerooted[k].second;
+  }
+
+  for (const auto &[v, newSize] : resized) {
+    lows[v] = lims[v] + 1 - newSize;
+  }
+}
+
+// Rerooting the subtree of the root at the node: the parent edges on the path
+// between them are reversed, the subtrees hanging from the path are kept.
+// The new postorder of the subtree with the lows relative to its beginning
+// is put into rerooted, the path nodes follow all the hanging subtrees.
+void NetworkSimplex::rerootSubtree(NodeId id, NodeId root, uint32_t parentEdge) {
+  rerootPath.clear();
+  for (NodeId v = id; v != root; v = getParentNode(v)) {
+    rerootPath.push_back(v);
+  }
+  rerootPath.push_back(root);
+
+  rerooted.clear();
+  uint32_t belowLow = 0;
+  uint32_t belowLim = None;
+  for (NodeId v : rerootPath) {
+    // The hanging subtrees are the subtree of v without v itself and without
+    // the subtree of the path node below, so they form at most two blocks
+    const uint32_t low = lows[v];
+    const uint32_t lim = lims[v];
+    const uint32_t shift = rerooted.size();
+    const uint32_t firstEnd = belowLim == None ? lim : belowLow;
+    const uint32_t secondBegin = belowLim == None ? lim : belowLim + 1;
+    for (uint32_t k = low; k < firstEnd; k++) {
+      const NodeId u = postorder[k];
+      rerooted.emplace_back(u, lows[u] - low + shift);
+    }
+    for (uint32_t k = secondBegin; k < lim; k++) {
+      const NodeId u = postorder[k];
+      rerooted.emplace_back(u, lows[u] - secondBegin + firstEnd - low + shift);
+    }
+    belowLow = low;
+    belowLim = lim;
+    lows[v] = shift;
+  }
+  for (auto it = rerootPath.rbegin(); it != rerootPath.rend(); ++it) {
+    rerooted.emplace_back(*it, lows[*it]);
+  }
+
+  for (size_t i = rerootPath.size() - 1; i > 0; i--) {
+    parents[rerootPath[i]] = parents[rerootPath[i - 1]];
+  }
+  parents[id] = parentEdge;
+}
+
+size_t NetworkSimplex::optimize(size_t maxIterations) {
+  size_t iterations = 0;
+  for (; iterations < maxIterations; iterations++) {
+    const uint32_t e = leaveEdge();
+    if (e == None) {
+      break;
+    }
+    const uint32_t f = enterEdge(e);
+    if (f == None) {
+      break;
+    }
+    exchange(e, f);
+  }
+  return iterations;
+}
+
+// Moving every weakly connected component to start at rank 0
+void NetworkSimplex::normalize() {
+  std::vector<int> minRanks(roots.size(), INT_MAX);
+  for (NodeId i = 0; i < nodeCount; i++) {
+    minRanks[components[i]] = std::min(minRanks[components[i]], ranks[i]);
+  }
+  for (NodeId i = 0; i < nodeCount; i++) {
+    ranks[i] -= minRanks[components[i]];
+  }
+}
+
+size_t NetworkSimplex::getDummyCount() const {
+  size_t count = 0;
+  for (uint32_t e = 0; e < tails.size(); e++) {
+    count += getSlack(e);
+  }
+  return count;
+}
+
+void assignLayer(
+    NodeStore &nodes, NodeId id, int layer, std::vector<int> &lensLayer) {
+  if (static_cast<size_t>(layer) >= lensLayer.size()) {
+    lensLayer.resize(layer + 1, 0);
+  }
+  nodes.layers[id] = layer;
+  nodes.numbers[id] = lensLayer[layer]++;
+}
+
+// The predecessors over the edges kept by the cycle breaking
+Adjacency getKeptPredecessors(
+    const Adjacency &succ, const std::vector<bool> &deletedEdges) {
+  const size_t nodeCount = succ.getNodeCount();
+  Adjacency pred;
+  pred.offsets.assign(nodeCount + 1, 0);
+  for (size_t e = 0; e < succ.ids.size(); e++) {
+    if (!deletedEdges[e]) {
+      pred.offsets[succ.ids[e] + 1]++;
+    }
+  }
+  for (size_t i = 0; i < nodeCount; i++) {
+    pred.offsets[i + 1] += pred.offsets[i];
+  }
+  pred.ids.resize(pred.offsets.back());
+  std::vector<uint32_t> fills(pred.offsets.begin(), pred.offsets.end() - 1);
+  for (NodeId id = 0; id < nodeCount; id++) {
+    for (size_t e = succ.offsets[id]; e < succ.offsets[id + 1]; e++) {
+      if (!deletedEdges[e]) {
+        pred.ids[fills[succ.ids[e]]++] = id;
+      }
+    }
+  }
+  return pred;
+}
+
+// Labeling the nodes from the sources: among the nodes with all the
+// predecessors labeled the one with the lexicographically smallest
+// decreasing sequence of the predecessor labels gets the next label.
+// The sequence of a node is fixed once it is ready, so a heap is enough.
+std::vector<uint32_t> getCoffmanGrahamLabels(
+    const Adjacency &succ,
+    const std::vector<bool> &deletedEdges,
+    const Adjacency &pred) {
+  const size_t nodeCount = succ.getNodeCount();
+  const std::vector<uint32_t> &offsets = pred.offsets;
+
+  // The predecessor labels of the i-th node are put to keys[offsets[i]],
+  // ..., keys[fills[i] - 1] in the increasing order
+  std::vector<uint32_t> keys(offsets.back());
+  std::vector<uint32_t> fills(offsets.begin(), offsets.end() - 1);
+
+  // The sequences are stored reversed, so they are compared from the back
+  auto isGreater = [&](NodeId lhs, NodeId rhs) {
+    const auto lhsFirst = keys.rbegin() + (keys.size() - offsets[lhs + 1]);
+    const auto lhsLast = keys.rbegin() + (keys.size() - offsets[lhs]);
+    const auto rhsFirst = keys.rbegin() + (keys.size() - offsets[rhs + 1]);
+    const auto rhsLast = keys.rbegin() + (keys.size() - offsets[rhs]);
+    const auto [lhsIt, rhsIt] =
+        std::mismatch(lhsFirst, lhsLast, rhsFirst, rhsLast);
+    if (lhsIt == lhsLast && rhsIt == rhsLast) {
+      return lhs > rhs;
+    }
+    return rhsIt == rhsLast || (lhsIt != lhsLast && *lhsIt > *rhsIt);
+  };
+  std::priority_queue<NodeId, std::vector<NodeId>, decltype(isGreater)>
+      ready(isGreater);
+  for (NodeId id = 0; id < nodeCount; id++) {
+    if (offsets[id] == offsets[id + 1]) {
+      ready.push(id);
+    }
+  }
+
+  std::vector<uint32_t> labels(nodeCount);
+  uint32_t label = 0;
+  while (!ready.empty()) {
+    const NodeId id = ready.top();
+    ready.pop();
+    labels[id] = label;
+    for (size_t e = succ.offsets[id]; e < succ.offsets[id + 1]; e++) {
+      if (deletedEdges[e]) {
+        continue;
+      }
+      const NodeId next = succ.ids[e];
+      keys[fills[next]++] = label;
+      if (fills[next] == offsets[next + 1]) {
+        ready.push(next);
+      }
+    }
+    label++;
+  }
+  assert(label == nodeCount && "the net must be acyclic");
+  return labels;
+}
+
+} // end namespace
+
+void assignCoffmanGrahamLayers(
+    NodeStore &nodes,
+    const Adjacency &succ,
+    const std::vector<bool> &deletedEdges,
+    std::vector<int> &lensLayer,
+    size_t maxWidth) {
+  const size_t nodeCount = succ.getNodeCount();
+  const Adjacency pred = getKeptPredecessors(succ, deletedEdges);
+  const std::vector<uint32_t> labels =
+      getCoffmanGrahamLabels(succ, deletedEdges, pred);
+
+  std::vector<uint32_t> degrees(nodeCount, 0);
+  for (NodeId id = 0; id < nodeCount; id++) {
+    for (NodeId prevId : pred[id]) {
+      degrees[prevId]++;
+    }
+  }
+
+  // Filling the layers from the sinks: the ready node of the greatest label
+  // goes to the current layer unless the layer is full or holds a successor
+  auto isLess = [&](NodeId lhs, NodeId rhs) {
+    return labels[lhs] < labels[rhs];
+  };
+  std::priority_queue<NodeId, std::vector<NodeId>, decltype(isLess)>
+      ready(isLess);
+  for (NodeId id = 0; id < nodeCount; id++) {
+    if (degrees[id] == 0) {
+      ready.push(id);
+    }
+  }
+
+  // The levels are counted from the sinks, minLevels are the lowest levels
+  // above all the placed successors
+  std::vector<int> minLevels(nodeCount, 0);
+  std::vector<NodeId> order;
+  order.reserve(nodeCount);
+  int level = 0;
+  size_t width = 0;
+  while (!ready.empty()) {
+    const NodeId id = ready.top();
+    ready.pop();
+    if (width == maxWidth || minLevels[id] > level) {
+      level++;
+      width = 0;
+    }
+    nodes.layers[id] = level;
+    width++;
+    order.push_back(id);
+
+    for (NodeId prevId : pred[id]) {
+      minLevels[prevId] = std::max(minLevels[prevId], level + 1);
+      if (--degrees[prevId] == 0) {
+        ready.push(prevId);
+      }
+    }
+  }
+  assert(order.size() == nodeCount && "the net must be acyclic");
+
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    assignLayer(nodes, *it, level - nodes.layers[*it], lensLayer);
+  }
+}
+
+void assignNetworkSimplexLayers(
+    NodeStore &nodes,
+    const Adjacency &succ,
+    const std::vector<bool> &deletedEdges,
+    std::vector<int> &lensLayer,
+    size_t maxIterations,
+    LayeringStats &stats) {
+  NetworkSimplex simplex(succ, deletedEdges);
+  const std::vector<NodeId> order = simplex.initRanks();
+  stats.initialDummyCount = simplex.getDummyCount();
+
+  simplex.buildFeasibleTree();
+  stats.iterationCount = simplex.optimize(maxIterations);
+  simplex.normalize();
+
+  for (NodeId id : order) {
+    assignLayer(nodes, id, simplex.getRank(id), lensLayer);
+  }
+}
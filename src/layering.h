@@ -0,0 +1,49 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LAYERING_H_
+#define LAYERING_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "layout.h"
+
+// Layer assignment by the network simplex method: the total span of the
+// edges, i.e. the number of the dummy nodes plus the number of the edges, is
+// minimized. The edges marked by the cycle breaking are laid out reversed.
+// Every weakly connected component starts at layer 0. The number of the
+// pivots is limited by maxIterations, the result is a valid layering anyway.
+// The dummy counts before and after the pivots and the number of the pivots
+// are stored into stats.
+// Details on the algorithm can be found in:
+// E. R. Gansner, E. Koutsofios, S. C. North, K.-P. Vo, A Technique for
+// Drawing Directed Graphs, IEEE Transactions on Software Engineering, 1993.
+void assignNetworkSimplexLayers(
+    NodeStore &nodes,
+    const Adjacency &succ,
+    const std::vector<bool> &deletedEdges,
+    std::vector<int> &lensLayer,
+    size_t maxIterations,
+    LayeringStats &stats);
+
+// Layer assignment by the Coffman-Graham algorithm: no layer holds more than
+// maxWidth nodes, the dummy nodes added later are not counted. The edges
+// marked by the cycle breaking are ignored. No transitive reduction is
+// done, so the height bound of the original algorithm does not hold.
+// Details on the algorithm can be found in:
+// E. G. Coffman, R. L. Graham, Optimal Scheduling for Two-Processor Systems,
+// Acta Informatica, 1972.
+void assignCoffmanGrahamLayers(
+    NodeStore &nodes,
+    const Adjacency &succ,
+    const std::vector<bool> &deletedEdges,
+    std::vector<int> &lensLayer,
+    size_t maxWidth);
+
+#endif // LAYERING_H_
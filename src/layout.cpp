@@ -7,45 +7,81 @@
 //===----------------------------------------------------------------------===//
 
 #include "layout.h"
+#include "layering.h"
 #include "netfmt_bench.h"
 
 #include <algorithm>
 #include <cassert>
-#include <map>
-
-bool algorithmDFS(
-    const TreeNode &node,
-    std::vector<TreeNode> &nodes,
-    std::vector<bool> &usedId) {
-  usedId[node.id] = true;
-  for (TreeNode::Id succId : node.succ) {
-    if (usedId[succId]) {
-      return true;
-    }
-    bool exist = algorithmDFS(nodes[succId], nodes, usedId);
-    if (exist) {
-      return true;
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+// Tarjan's algorithm with an explicit stack of the visited nodes and their
+// next successor entries, so deep chains do not overflow the call stack.
+// The components are numbered in the reverse topological order. The edges
+// marked in ignoredEdges (if it is not empty) are skipped.
+size_t findStronglyConnectedComponents(
+    const Adjacency &succ,
+    const std::vector<bool> &ignoredEdges,
+    std::vector<uint32_t> &components) {
+  constexpr uint32_t None = UINT32_MAX;
+  const size_t nodeCount = succ.getNodeCount();
+
+  components.assign(nodeCount, None);
+  std::vector<uint32_t> indices(nodeCount, None);
+  std::vector<uint32_t> lowLinks(nodeCount);
+  std::vector<NodeId> visited;
+  std::vector<std::pair<NodeId, uint32_t>> path;
+  uint32_t index = 0;
+  uint32_t componentCount = 0;
+
+  auto visit = [&](NodeId id) {
+    indices[id] = lowLinks[id] = index++;
+    visited.push_back(id);
+    path.emplace_back(id, succ.offsets[id]);
+  };
+
+  for (NodeId root = 0; root < nodeCount; root++) {
+    if (indices[root] != None) {
+      continue;
     }
-  }
-  usedId[node.id] = false;
-  return false;
-}
-
-bool cycleExistsDFS(std::vector<TreeNode> &nodes) {
-  if (nodes.size() == 0) {
-    return false;
-  }
+    visit(root);
+
+    while (!path.empty()) {
+      const NodeId id = path.back().first;
+      const uint32_t e = path.back().second;
+      if (e < succ.offsets[id + 1]) {
+        path.back().second++;
+        if (!ignoredEdges.empty() && ignoredEdges[e]) {
+          continue;
+        }
+        const NodeId succId = succ.ids[e];
+        if (indices[succId] == None) {
+          visit(succId);
+        } else if (components[succId] == None) {
+          // The successor is still on the stack of the visited nodes
+          lowLinks[id] = std::min(lowLinks[id], indices[succId]);
+        }
+        continue;
+      }
 
-  std::vector<bool> usedId(nodes.size(), false);
-  for (size_t i = 0; i < nodes.size(); i++) {
-    if (nodes[i].pred.size() == 0) {
-      bool exist = algorithmDFS(nodes[i], nodes, usedId);
-      if (exist) {
-        return true;
+      path.pop_back();
+      if (!path.empty()) {
+        NodeId parentId = path.back().first;
+        lowLinks[parentId] = std::min(lowLinks[parentId], lowLinks[id]);
+      }
+      if (lowLinks[id] == indices[id]) {
+        NodeId member;
+        do {
+          member = visited.back();
+          visited.pop_back();
+          components[member] = componentCount;
+        } while (member != id);
+        componentCount++;
       }
     }
   }
-  return algorithmDFS(nodes[0], nodes, usedId);
+  return componentCount;
 }
 
 struct EdgeCount {
@@ -53,305 +89,527 @@ struct EdgeCount {
   int degIn = 0;
 };
 
-void removeEdgeCount(
-    int i,
-    std::vector<EdgeCount> &edgeCounts,
-    std::vector<TreeNode> &nodes) {
-  const TreeNode &node = nodes[i];
-  for (TreeNode::Id id : node.succ) {
-    edgeCounts[id].degIn--;
+// Node buckets of the greedy FAS heuristic: sinks, sources and the remaining
+// nodes grouped by (degOut - degIn). Every bucket is a doubly linked list
+// threaded through the next/prev arrays, so moving a node is O(1).
+class FASBuckets {
+  static constexpr size_t None = static_cast<size_t>(-1);
+
+  std::vector<size_t> heads;
+  std::vector<size_t> next;
+  std::vector<size_t> prev;
+  std::vector<size_t> bucketOf;
+  size_t sinkBucket;
+  size_t sourceBucket;
+  size_t maxDeltaBucket = 0;
+
+public:
+  explicit FASBuckets(size_t nodeCount)
+      : heads(2 * nodeCount + 3, None),
+        next(nodeCount, None),
+        prev(nodeCount, None),
+        bucketOf(nodeCount, None),
+        sinkBucket(2 * nodeCount + 1),
+        sourceBucket(2 * nodeCount + 2) {}
+
+  void insert(size_t i, const EdgeCount &count) {
+    size_t bucket;
+    if (count.degOut == 0) {
+      bucket = sinkBucket;
+    } else if (count.degIn == 0) {
+      bucket = sourceBucket;
+    } else {
+      // Self-loops and multiple edges may push the degrees above the number
+      // of the nodes, so the extreme deltas share the outermost buckets
+      long delta = static_cast<long>(count.degOut) - count.degIn;
+      bucket = std::clamp<long>(delta + next.size(), 0, sinkBucket - 1);
+      maxDeltaBucket = std::max(maxDeltaBucket, bucket);
+    }
+
+    bucketOf[i] = bucket;
+    prev[i] = None;
+    next[i] = heads[bucket];
+    if (next[i] != None) {
+      prev[next[i]] = i;
+    }
+    heads[bucket] = i;
   }
-  for (TreeNode::Id id : node.pred) {
-    edgeCounts[id].degOut--;
+
+  void erase(size_t i) {
+    if (prev[i] != None) {
+      next[prev[i]] = next[i];
+    } else {
+      heads[bucketOf[i]] = next[i];
+    }
+    if (next[i] != None) {
+      prev[next[i]] = prev[i];
+    }
+    bucketOf[i] = None;
   }
 
-  edgeCounts[i].degIn = -1;
-  edgeCounts[i].degOut = -1;
-}
+  bool contains(size_t i) const {
+    return bucketOf[i] != None;
+  }
 
-bool comparatorId(TreeNode &first, TreeNode &second) {
-  return first.id < second.id;
-}
+  size_t popSink() {
+    return pop(sinkBucket);
+  }
 
-size_t dispatchSinks(
-    std::vector<TreeNode> &nodes,
-    std::vector<EdgeCount> &edgeCounts,
-    std::vector<TreeNode::Id> &s2) {
-  size_t decrlenNodes = 0;
-  for (size_t i = 0; i < edgeCounts.size();) {
-    if (edgeCounts[i].degOut == 0) {
-      s2.push_back(i);
-      removeEdgeCount(i, edgeCounts, nodes);
-      decrlenNodes++;
+  size_t popSource() {
+    return pop(sourceBucket);
+  }
 
-      i = 0;
-    } else {
-      i++;
+  size_t popMaxDelta() {
+    while (heads[maxDeltaBucket] == None && maxDeltaBucket > 0) {
+      maxDeltaBucket--;
     }
+    return pop(maxDeltaBucket);
   }
-  return decrlenNodes;
-}
 
-size_t dispatchSources(
-    std::vector<TreeNode> &nodes,
-    std::vector<EdgeCount> &edgeCounts,
-    std::vector<TreeNode::Id> &s1) {
-  size_t decrlenNodes = 0;
-  for (size_t i = 0; i < edgeCounts.size();) {
-    if (edgeCounts[i].degIn == 0) {
-      s1.push_back(i);
-      removeEdgeCount(i, edgeCounts, nodes);
-      decrlenNodes++;
+private:
+  size_t pop(size_t bucket) {
+    size_t i = heads[bucket];
+    if (i != None) {
+      erase(i);
+    }
+    return i;
+  }
+};
 
-      i = 0;
-    } else {
-      i++;
+void removeEdgeCount(
+    size_t i,
+    std::vector<EdgeCount> &edgeCounts,
+    const Adjacency &succ,
+    const Adjacency &pred,
+    FASBuckets &buckets) {
+  for (NodeId id : succ[i]) {
+    if (buckets.contains(id)) {
+      buckets.erase(id);
+      edgeCounts[id].degIn--;
+      buckets.insert(id, edgeCounts[id]);
+    }
+  }
+  for (NodeId id : pred[i]) {
+    if (buckets.contains(id)) {
+      buckets.erase(id);
+      edgeCounts[id].degOut--;
+      buckets.insert(id, edgeCounts[id]);
     }
   }
-  return decrlenNodes;
 }
 
-// Finding and removing the minimum number of arcs to remove all cycles
+// Finding the minimum number of arcs to remove all cycles: deletedEdges marks
+// the successor entries to be ignored while assigning the layers
 // ADetails on the algorithm used can be found in:
 // Jannis Pohlmann, Configurable Graph Drawing Algorithms for the TikZ Graphics
 // Description Language, Diploma Thesis, Institute of Theoretical Computer
 // Science, Universität zu Lübeck, 2011.
+// The nodes are kept in buckets as proposed by Eades, Lin and Smyth (A fast
+// and effective heuristic for the feedback arc set problem, 1993), so the
+// whole pass takes O(V + E) time.
 void greedyFAS(
-    std::vector<TreeNode> &nodes,
-    std::vector<std::pair<TreeNode::Id, TreeNode::Id>> &deletedEdges) {
-  std::vector<TreeNode::Id> s1 = {}, s2 = {};
+    const Adjacency &succ,
+    const Adjacency &pred,
+    std::vector<bool> &deletedEdges) {
+  const size_t nodeCount = succ.getNodeCount();
+  std::vector<NodeId> s1 = {}, s2 = {};
 
   std::vector<EdgeCount> edgeCounts;
-  edgeCounts.reserve(nodes.size());
-  for (const TreeNode &node : nodes) {
-    edgeCounts.push_back({static_cast<int>(node.succ.size()),
-                          static_cast<int>(node.pred.size())});
-  }
-
-  size_t lenNodes = nodes.size();
-  while (lenNodes > 0) {
-    lenNodes -= dispatchSinks(nodes, edgeCounts, s2);
-    lenNodes -= dispatchSources(nodes, edgeCounts, s1);
-
-    if (lenNodes > 0) {
-      int max;
-      for (size_t i = 0; i < edgeCounts.size(); i++) {
-        if (edgeCounts[i].degOut >= 0 && edgeCounts[i].degIn >= 0) {
-          max = i;
-          break;
-        }
-      }
-      for (size_t i = 0; i < edgeCounts.size(); i++) {
-        if (edgeCounts[i].degOut - edgeCounts[i].degIn > max &&
-            edgeCounts[i].degOut >= 0 && edgeCounts[i].degIn >= 0) {
-          max = i;
-        }
-      }
-
-      s1.push_back(max);
-      removeEdgeCount(max, edgeCounts, nodes);
+  edgeCounts.reserve(nodeCount);
+  FASBuckets buckets(nodeCount);
+  for (size_t i = 0; i < nodeCount; i++) {
+    edgeCounts.push_back({static_cast<int>(succ[i].size()),
+                          static_cast<int>(pred[i].size())});
+    buckets.insert(i, edgeCounts.back());
+  }
 
-      lenNodes--;
+  for (size_t lenNodes = nodeCount; lenNodes > 0; lenNodes--) {
+    size_t i = buckets.popSink();
+    if (i != static_cast<size_t>(-1)) {
+      s2.push_back(i);
+    } else {
+      i = buckets.popSource();
+      if (i == static_cast<size_t>(-1)) {
+        i = buckets.popMaxDelta();
+      }
+      s1.push_back(i);
     }
+    removeEdgeCount(i, edgeCounts, succ, pred, buckets);
   }
 
-  std::map<TreeNode::Id, TreeNode::Id> mp;
-  int index = 0;
+  std::vector<size_t> order(nodeCount);
+  size_t index = 0;
   for (auto it = s1.begin(), end = s1.end(); it != end; ++it) {
-    mp[*it] = index++;
+    order[*it] = index++;
   }
   for (auto it = s2.rbegin(), end = s2.rend(); it != end; ++it) {
-    mp[*it] = index++;
+    order[*it] = index++;
   }
 
-  for (TreeNode &node : nodes) {
-    for (int j = node.succ.size() - 1; j >= 0; j--) {
-      if (mp[node.id] > mp[node.succ[j]]) {
-        auto edge = std::make_pair(node.id, node.succ[j]);
-        deletedEdges.push_back(edge);
-
-        TreeNode &succ = nodes[node.succ[j]];
-        succ.pred.erase(
-            std::remove(succ.pred.begin(), succ.pred.end(), node.id),
-            succ.pred.end());
-        node.succ.erase(node.succ.begin() + j);
-      }
+  // Self-loops are deleted as well, otherwise no layering exists
+  deletedEdges.assign(succ.ids.size(), false);
+  for (size_t i = 0; i < nodeCount; i++) {
+    for (size_t e = succ.offsets[i]; e < succ.offsets[i + 1]; e++) {
+      deletedEdges[e] = order[i] >= order[succ.ids[e]];
     }
   }
 }
 
-// Assigning a layer and numbers in this layer for each vertex of the graph
-void algorithmASAP(
-    std::vector<TreeNode> &nodes,
-    std::vector<std::pair<TreeNode::Id, TreeNode::Id>> &deletedEdges,
-    std::vector<int> &lensLayer) {
-  std::vector<int> removedNodes(nodes.size(), -1);
+void assignNumber(NodeStore &nodes, NodeId id, std::vector<int> &lensLayer) {
+  if (static_cast<size_t>(nodes.layers[id]) == lensLayer.size()) {
+    lensLayer.push_back(0);
+  }
+  nodes.numbers[id] = lensLayer[nodes.layers[id]]++;
+}
 
-  std::vector<int> degInNodes;
-  degInNodes.reserve(nodes.size());
-  for (const TreeNode &node : nodes) {
-    degInNodes.push_back(node.pred.size());
+// Assigning a layer and numbers in this layer for each vertex of the graph.
+// The layers are the longest path lengths from the sources (ASAP) or to the
+// sinks (ALAP). The former are computed while the Kahn-style worklist is
+// filled, the latter are computed over the reversed worklist, so every node
+// and edge is visited once or twice
+void algorithmLongestPath(
+    NodeStore &nodes,
+    const Adjacency &succ,
+    const std::vector<bool> &deletedEdges,
+    std::vector<int> &lensLayer,
+    Layering layering) {
+  const bool fromSources = layering == Layering::ASAP;
+  std::vector<int> &layers = nodes.layers;
+
+  std::vector<uint32_t> degrees(nodes.size(), 0);
+  for (size_t e = 0; e < succ.ids.size(); e++) {
+    if (!deletedEdges[e]) {
+      degrees[succ.ids[e]]++;
+    }
   }
 
-  int nodesInLayer = 0;
-  size_t removedCount = 0;
-  for (size_t i = 0; removedCount < nodes.size(); i++) {
-    for (size_t j = 0; j < nodes.size(); j++) {
-      if (degInNodes[j] == 0 && removedNodes[j] == -1) {
-        removedNodes[j] = 0;
-        removedCount++;
-      }
+  std::vector<NodeId> worklist;
+  worklist.reserve(nodes.size());
+  for (NodeId id = 0; id < nodes.size(); id++) {
+    layers[id] = 0;
+    if (degrees[id] == 0) {
+      worklist.push_back(id);
     }
+  }
 
-    for (size_t j = 0; j < nodes.size(); j++) {
-      if (removedNodes[j] == 0) {
-        nodes[j].layer = i;
-        nodes[j].number = nodesInLayer;
-        nodesInLayer++;
+  for (size_t i = 0; i < worklist.size(); i++) {
+    NodeId id = worklist[i];
+    if (fromSources) {
+      assignNumber(nodes, id, lensLayer);
+    }
 
-        for (size_t k = 0; k < nodes[j].succ.size(); k++) {
-          degInNodes[nodes[j].succ[k]]--;
-        }
-        removedNodes[j] = 1;
+    for (size_t e = succ.offsets[id]; e < succ.offsets[id + 1]; e++) {
+      if (deletedEdges[e]) {
+        continue;
+      }
+      NodeId nextId = succ.ids[e];
+      if (fromSources) {
+        layers[nextId] = std::max(layers[nextId], layers[id] + 1);
+      }
+      if (--degrees[nextId] == 0) {
+        worklist.push_back(nextId);
       }
     }
-    lensLayer.push_back(nodesInLayer);
-    nodesInLayer = 0;
   }
+  assert(worklist.size() == nodes.size() && "the net must be acyclic");
+
+  if (!fromSources) {
+    for (auto it = worklist.rbegin(), end = worklist.rend(); it != end; ++it) {
+      NodeId id = *it;
+      for (size_t e = succ.offsets[id]; e < succ.offsets[id + 1]; e++) {
+        if (!deletedEdges[e]) {
+          layers[id] = std::max(layers[id], layers[succ.ids[e]] + 1);
+        }
+      }
+      assignNumber(nodes, id, lensLayer);
+    }
 
-  for (auto [src, dst] : deletedEdges) {
-    nodes[src].succ.push_back(dst);
-    nodes[dst].pred.push_back(src);
+    const int lastLayer = static_cast<int>(lensLayer.size()) - 1;
+    for (int &layer : layers) {
+      layer = lastLayer - layer;
+    }
+    std::reverse(lensLayer.begin(), lensLayer.end());
   }
 }
 
+// Replacing the successor entry e of the start node with a chain of dummy
+// nodes, one per crossed layer. The dummy nodes and their adjacency rows are
+// appended to the end of the arrays
 void addLineSegment(
-    std::vector<TreeNode> &nodes,
+    NodeStore &nodes,
+    Adjacency &succ,
+    Adjacency &pred,
     std::vector<int> &lensLayer,
-    size_t idStart,
-    size_t idEnd,
-    bool isDownward) {
-  int order;
-  if (isDownward) {
-    order = 1;
-  } else {
-    order = -1;
-  }
-
-  int idPrevSucc = nodes[idStart].succ[idEnd];
-  nodes[idStart].succ[idEnd] = nodes.size();
-  for (int i = nodes[idStart].layer + order;
-       (i < nodes[idPrevSucc].layer && order == 1) ||
-       (i > nodes[idPrevSucc].layer && order == -1);
-       i += order) {
-    TreeNode dummy = {};
-    dummy.isDummy = true;
-    dummy.id = static_cast<int>(nodes.size());
-    dummy.layer = i;
-    dummy.number = lensLayer[i];
-    lensLayer[i]++;
-    if (i == nodes[idStart].layer + order) {
-      dummy.pred.push_back(idStart);
-    } else {
-      dummy.pred.push_back(dummy.id - 1);
+    NodeId idStart,
+    size_t e) {
+  NodeId idEnd = succ.ids[e];
+  const int startLayer = nodes.layers[idStart];
+  const int endLayer = nodes.layers[idEnd];
+  const int order = endLayer > startLayer ? 1 : -1;
+
+  NodeId idPrev = idStart;
+  for (int i = startLayer + order; i != endLayer; i += order) {
+    NodeId dummyId = nodes.add(true);
+    nodes.layers[dummyId] = i;
+    nodes.numbers[dummyId] = lensLayer[i]++;
+    succ.addRow(i + order == endLayer ? idEnd : dummyId + 1);
+    pred.addRow(idPrev);
+
+    if (idPrev == idStart) {
+      succ.ids[e] = dummyId;
     }
-    if (i + order == nodes[idPrevSucc].layer) {
-      dummy.succ.push_back(idPrevSucc);
-      nodes[idPrevSucc].pred.push_back(dummy.id);
-    } else {
-      dummy.succ.push_back(dummy.id + 1);
-    }
-    nodes.push_back(dummy);
+    idPrev = dummyId;
   }
 
-  for (size_t i = 0; i < nodes[idPrevSucc].pred.size(); i++) {
-    if (nodes[idPrevSucc].pred[i] == idStart) {
-      nodes[idPrevSucc].pred.erase(nodes[idPrevSucc].pred.begin() + i);
-      break;
-    }
-  }
+  Span<NodeId> endPred = pred[idEnd];
+  *std::find(endPred.begin(), endPred.end(), idStart) = idPrev;
 }
 
-bool addDummyNodes(std::vector<TreeNode> &nodes, std::vector<int> &lensLayer) {
-  for (TreeNode &node : nodes) {
-    for (size_t j = 0; j < node.succ.size(); j++) {
-      int distance = nodes[node.succ[j]].layer - node.layer;
-      if (distance > 1 || distance < -1) {
-        addLineSegment(nodes, lensLayer, node.id, j, distance > 1);
-        return false;
+// Introducing dummy vertices for the edges spanning several layers. All the
+// chains are counted first, so the arrays are reallocated only once
+void addAllDummyNodes(
+    NodeStore &nodes,
+    Adjacency &succ,
+    Adjacency &pred,
+    std::vector<int> &lensLayer) {
+  const size_t nodeCount = nodes.size();
+  const size_t edgeCount = succ.ids.size();
+
+  size_t dummyCount = 0;
+  for (NodeId i = 0; i < nodeCount; i++) {
+    for (NodeId succId : succ[i]) {
+      int distance = std::abs(nodes.layers[succId] - nodes.layers[i]);
+      if (distance > 1) {
+        dummyCount += distance - 1;
       }
     }
   }
-  return true;
-}
 
-void addAllDummyNodes(
-    std::vector<TreeNode> &nodes,
-    std::vector<int> &lensLayer) {
-  bool allDummysAdded = false;
-  while (!allDummysAdded) {
-    allDummysAdded = addDummyNodes(nodes, lensLayer);
+  nodes.reserve(nodeCount + dummyCount);
+  succ.offsets.reserve(nodeCount + dummyCount + 1);
+  succ.ids.reserve(edgeCount + dummyCount);
+  pred.offsets.reserve(nodeCount + dummyCount + 1);
+  pred.ids.reserve(edgeCount + dummyCount);
+  for (NodeId i = 0; i < nodeCount; i++) {
+    for (size_t e = succ.offsets[i]; e < succ.offsets[i + 1]; e++) {
+      int distance = std::abs(nodes.layers[succ.ids[e]] - nodes.layers[i]);
+      if (distance > 1) {
+        addLineSegment(nodes, succ, pred, lensLayer, i, e);
+      }
+    }
   }
+  assert(nodes.size() == nodeCount + dummyCount);
 }
 
-TreeNode::Id Net::addNode() {
-  Id id = static_cast<Id>(nodes.size());
-  nodes.emplace_back();
-  nodes.back().id = id;
+NodeId Net::addNode(std::string_view name) {
+  assert(!adjacencyBuilt);
+  names.add(name);
+  return nodes.add(false);
+}
 
-  return id;
+void Net::markDff(NodeId id) {
+  assert(hasNode(id));
+  nodes.dffs[id] = true;
 }
 
-const std::vector<TreeNode::Id> &Net::getSources() {
+const std::vector<NodeId> &Net::getSources() {
   if (!sourcesCalculated) {
-    for (size_t i = 0; i < nodes.size(); i++) {
-      if (nodes[i].pred.size() == 0) {
-        sources.push_back(nodes[i].id);
+    for (Id i = 0; i < nodes.size(); i++) {
+      if (pred[i].empty()) {
+        sources.push_back(i);
       }
     }
+    sourcesCalculated = true;
   }
   return sources;
 }
 
-const std::vector<TreeNode::Id> &Net::getSinks() {
+const std::vector<NodeId> &Net::getSinks() {
   if (!sinksCalculated) {
-    for (size_t i = 0; i < nodes.size(); i++) {
-      if (nodes[i].succ.size() == 0) {
-        sinks.push_back(nodes[i].id);
+    for (Id i = 0; i < nodes.size(); i++) {
+      if (succ[i].empty()) {
+        sinks.push_back(i);
       }
     }
+    sinksCalculated = true;
   }
   return sinks;
 }
 
-const std::vector<TreeNode::Id> &Net::getSuccessors(TreeNode::Id id) const {
-  const TreeNode *node = getNode(id);
-  assert(node);
-  return node->succ;
+Span<const NodeId> Net::getSuccessors(NodeId id) const {
+  assert(adjacencyBuilt && hasNode(id));
+  return succ[id];
+}
+
+Span<const NodeId> Net::getPredecessors(NodeId id) const {
+  assert(adjacencyBuilt && hasNode(id));
+  return pred[id];
+}
+
+Span<NodeId> Net::getSuccessors(NodeId id) {
+  assert(adjacencyBuilt && hasNode(id));
+  return succ[id];
+}
+
+Span<NodeId> Net::getPredecessors(NodeId id) {
+  assert(adjacencyBuilt && hasNode(id));
+  return pred[id];
+}
+
+void Net::linkNodes(NodeId src, NodeId dst) {
+  assert(!adjacencyBuilt && hasNode(src) && hasNode(dst));
+  linkedEdges.emplace_back(src, dst);
+}
+
+// Counting sort of the edges by their source (or destination) keeping the
+// order in which the edges were linked
+void fillAdjacency(
+    Adjacency &adjacency,
+    size_t nodeCount,
+    const std::vector<std::pair<NodeId, NodeId>> &edges,
+    bool bySource) {
+  adjacency.offsets.assign(nodeCount + 1, 0);
+  for (auto [src, dst] : edges) {
+    adjacency.offsets[(bySource ? src : dst) + 1]++;
+  }
+  for (size_t i = 0; i < nodeCount; i++) {
+    adjacency.offsets[i + 1] += adjacency.offsets[i];
+  }
+
+  std::vector<uint32_t> filled(adjacency.offsets.begin(),
+                               adjacency.offsets.end() - 1);
+  adjacency.ids.resize(edges.size());
+  for (auto [src, dst] : edges) {
+    adjacency.ids[filled[bySource ? src : dst]++] = bySource ? dst : src;
+  }
 }
 
-const std::vector<TreeNode::Id> &Net::getPredecessors(TreeNode::Id id) const {
-  const TreeNode *node = getNode(id);
-  assert(node);
-  return node->pred;
+void Net::buildAdjacency() {
+  assert(!adjacencyBuilt);
+  fillAdjacency(succ, nodes.size(), linkedEdges, true);
+  fillAdjacency(pred, nodes.size(), linkedEdges, false);
+
+  linkedEdges.clear();
+  linkedEdges.shrink_to_fit();
+  adjacencyBuilt = true;
 }
 
-const TreeNode *Net::getNode(TreeNode::Id id) const {
-  if (id >= 0 && id < nodes.size()) {
-    return nodes.data() + id;
+// Cutting the edges leaving the DFF outputs: every cycle of a sequential
+// circuit passes through a register, so this usually breaks all of them
+void cutDffOutputs(
+    const NodeStore &nodes,
+    const Adjacency &succ,
+    std::vector<bool> &deletedEdges) {
+  for (NodeId i = 0; i < succ.getNodeCount(); i++) {
+    if (nodes.dffs[i]) {
+      std::fill(deletedEdges.begin() + succ.offsets[i],
+                deletedEdges.begin() + succ.offsets[i + 1], true);
+    }
+  }
+}
+
+// Marking more edges to be ignored to make the net acyclic. The edges between
+// the strongly connected components never close a cycle, so the feedback
+// arc set is searched only inside the non-trivial components of the net
+// without the already deleted edges.
+void breakCycles(
+    const Adjacency &succ,
+    std::vector<bool> &deletedEdges) {
+  const size_t nodeCount = succ.getNodeCount();
+  std::vector<uint32_t> components;
+  const size_t componentCount =
+      findStronglyConnectedComponents(succ, deletedEdges, components);
+
+  std::vector<uint32_t> componentSizes(componentCount, 0);
+  for (uint32_t component : components) {
+    componentSizes[component]++;
+  }
+
+  // The subgraph induced by the non-trivial components, its edges keep
+  // the indices of the original successor entries
+  constexpr NodeId None = UINT32_MAX;
+  std::vector<NodeId> localIds(nodeCount, None);
+  size_t localCount = 0;
+  for (NodeId i = 0; i < nodeCount; i++) {
+    if (componentSizes[components[i]] > 1) {
+      localIds[i] = localCount++;
+    }
+  }
+
+  std::vector<std::pair<NodeId, NodeId>> localEdges;
+  std::vector<size_t> edgeIndices;
+  for (NodeId i = 0; i < nodeCount; i++) {
+    for (size_t e = succ.offsets[i]; e < succ.offsets[i + 1]; e++) {
+      const NodeId succId = succ.ids[e];
+      if (deletedEdges[e]) {
+        continue;
+      }
+      if (succId == i) {
+        // Self-loops are deleted as well, otherwise no layering exists
+        deletedEdges[e] = true;
+      } else if (localIds[i] != None && components[i] == components[succId]) {
+        localEdges.emplace_back(localIds[i], localIds[succId]);
+        edgeIndices.push_back(e);
+      }
+    }
+  }
+  if (localEdges.empty()) {
+    return;
+  }
+
+  Adjacency localSucc, localPred;
+  fillAdjacency(localSucc, localCount, localEdges, true);
+  fillAdjacency(localPred, localCount, localEdges, false);
+  std::vector<bool> localDeletedEdges;
+  greedyFAS(localSucc, localPred, localDeletedEdges);
+
+  // The local edges are listed by their source, as the successor entries are
+  for (size_t k = 0; k < edgeIndices.size(); k++) {
+    if (localDeletedEdges[k]) {
+      deletedEdges[edgeIndices[k]] = true;
+    }
   }
-  return nullptr;
 }
 
+size_t Net::getStronglyConnectedComponents(
+    std::vector<uint32_t> &components) const {
+  assert(adjacencyBuilt);
+  return findStronglyConnectedComponents(succ, {}, components);
+}
+
+// The network simplex usually converges in far fewer pivots, the limit only
+// bounds the time on the pathological nets
+constexpr size_t NetworkSimplexMaxIterations = 100000;
+
 // Assigning a layer and a number, introducing dummy vertices
-void Net::assignLayers() {
-  std::vector<std::pair<TreeNode::Id, TreeNode::Id>> deletedEdges = {};
-  greedyFAS(nodes, deletedEdges);
+LayeringStats Net::assignLayers(
+    Layering layering, CycleBreaking cycleBreaking, size_t maxLayerWidth) {
+  assert(adjacencyBuilt);
+  std::vector<bool> deletedEdges(succ.ids.size(), false);
+  if (cycleBreaking == CycleBreaking::DFF) {
+    cutDffOutputs(nodes, succ, deletedEdges);
+  }
+  breakCycles(succ, deletedEdges);
 
+  LayeringStats stats;
   std::vector<int> lensLayer = {};
-  algorithmASAP(nodes, deletedEdges, lensLayer);
+  if (layering == Layering::NetworkSimplex) {
+    assignNetworkSimplexLayers(
+        nodes, succ, deletedEdges, lensLayer, NetworkSimplexMaxIterations, stats);
+  } else if (layering == Layering::CoffmanGraham) {
+    if (maxLayerWidth == 0) {
+      maxLayerWidth = std::ceil(std::sqrt(nodes.size()));
+    }
+    assignCoffmanGrahamLayers(
+        nodes, succ, deletedEdges, lensLayer, maxLayerWidth);
+  } else {
+    algorithmLongestPath(nodes, succ, deletedEdges, lensLayer, layering);
+  }
 
-  addAllDummyNodes(nodes, lensLayer);
+  const size_t nodeCount = nodes.size();
+  addAllDummyNodes(nodes, succ, pred, lensLayer);
+  stats.dummyCount = nodes.size() - nodeCount;
+  return stats;
 }
 
 enum {
@@ -362,18 +620,18 @@ enum {
 };
 
 void initPositionAndSize(
-    std::vector<TreeNode> &nodes,
+    const NodeStore &nodes,
     std::vector<NormalizedElement> &normalizedElements,
     float nCellSize) {
-  for (TreeNode &node : nodes) {
+  for (NodeId id = 0; id < nodes.size(); id++) {
     NormalizedElement nElement = {};
-    nElement.id = node.id;
+    nElement.id = id;
 
-    if (node.isDummy) {
+    if (nodes.dummies[id]) {
       NormalizedPoint nPoint = {};
-      nPoint.nX = nCellSize * node.number +
+      nPoint.nX = nCellSize * nodes.numbers[id] +
                   (nCellSize / ReductionWidth) / ReductionRelationToGap;
-      nPoint.nY = nCellSize * node.layer +
+      nPoint.nY = nCellSize * nodes.layers[id] +
                   (nCellSize / ReductionHeight) / ReductionRelationToGap;
 
       nElement.nPoint = nPoint;
@@ -381,8 +639,8 @@ void initPositionAndSize(
       nElement.nW = 0;
     } else {
       NormalizedPoint nPoint = {};
-      nPoint.nX = nCellSize * node.number;
-      nPoint.nY = nCellSize * node.layer;
+      nPoint.nX = nCellSize * nodes.numbers[id];
+      nPoint.nY = nCellSize * nodes.layers[id];
 
       nElement.nPoint = nPoint;
       nElement.nH = nCellSize / ReductionHeight;
@@ -394,15 +652,16 @@ void initPositionAndSize(
 }
 
 void initConnections(
-    std::vector<TreeNode> &nodes,
+    const NodeStore &nodes,
+    const Adjacency &succ,
     std::vector<NormalizedElement> &normalizedElements) {
   int countConnections = 0;
-  for (size_t i = 0; i < nodes.size(); i++) {
-    for (size_t &succId : nodes[i].succ) {
+  for (NodeId i = 0; i < nodes.size(); i++) {
+    for (NodeId succId : succ[i]) {
       NormalizedConnection connection = {};
 
       connection.id = countConnections;
-      connection.startElementId = nodes[i].id;
+      connection.startElementId = i;
       connection.endElementId = succId;
 
       NormalizedPoint nPointStart = {};
@@ -429,12 +688,14 @@ void initConnections(
 void Net::netTreeNodesToNormalizedElements(
     std::vector<NormalizedElement> &normalizedElements) {
   float maxNumber = -1, maxLayer = -1;
-  for (TreeNode &node : nodes) {
-    if (node.layer > maxLayer) {
-      maxLayer = node.layer;
+  for (int layer : nodes.layers) {
+    if (layer > maxLayer) {
+      maxLayer = layer;
     }
-    if (node.number > maxNumber) {
-      maxNumber = node.number;
+  }
+  for (int number : nodes.numbers) {
+    if (number > maxNumber) {
+      maxNumber = number;
     }
   }
   float nCellSize = -1;
@@ -447,5 +708,5 @@ void Net::netTreeNodesToNormalizedElements(
 
   initPositionAndSize(nodes, normalizedElements, nCellSize);
 
-  initConnections(nodes, normalizedElements);
+  initConnections(nodes, succ, normalizedElements);
 }
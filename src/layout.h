@@ -9,29 +9,139 @@
 #ifndef LAYOUT_H_
 #define LAYOUT_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include "main.h"
+#include "names.h"
 
-struct TreeNode {
-  using Id = size_t;
+// A view of the contiguous elements [first, last)
+template <typename T>
+class Span {
+  T *first = nullptr;
+  T *last = nullptr;
 
-  std::vector<Id> succ = {};
-  std::vector<Id> pred = {};
-  Id id = 0;
-  int layer = 0;
-  int number = 0;
-  bool isDummy = false;
-  float barycentricValue = 0;
+public:
+  Span() = default;
+  Span(T *first, T *last): first(first), last(last) {}
+
+  T *begin() const { return first; }
+  T *end() const { return last; }
+  size_t size() const { return last - first; }
+  bool empty() const { return first == last; }
+  T &operator[](size_t i) const { return first[i]; }
+  T &back() const { return last[-1]; }
+};
+
+using NodeId = uint32_t;
+
+// Node attributes stored as parallel arrays indexed by the node id, so that
+// every pass only loads the attributes it works with
+struct NodeStore {
+  using Id = NodeId;
+
+  std::vector<int> layers = {};
+  std::vector<int> numbers = {};
+  std::vector<float> barycentricValues = {};
+  std::vector<uint8_t> dummies = {};
+  // The node is driven by a DFF
+  std::vector<uint8_t> dffs = {};
+
+  size_t size() const {
+    return layers.size();
+  }
+
+  void reserve(size_t nodeCount) {
+    layers.reserve(nodeCount);
+    numbers.reserve(nodeCount);
+    barycentricValues.reserve(nodeCount);
+    dummies.reserve(nodeCount);
+    dffs.reserve(nodeCount);
+  }
+
+  Id add(bool isDummy) {
+    layers.push_back(0);
+    numbers.push_back(0);
+    barycentricValues.push_back(0);
+    dummies.push_back(isDummy);
+    dffs.push_back(false);
+    return static_cast<Id>(layers.size() - 1);
+  }
+};
+
+// Adjacency lists in the compressed sparse row format: the neighbours of
+// the i-th node are ids[offsets[i]], ..., ids[offsets[i + 1] - 1]
+struct Adjacency {
+  using Id = NodeId;
+
+  std::vector<uint32_t> offsets = {0};
+  std::vector<Id> ids = {};
+
+  Span<Id> operator[](Id id) {
+    return {ids.data() + offsets[id], ids.data() + offsets[id + 1]};
+  }
+
+  Span<const Id> operator[](Id id) const {
+    return {ids.data() + offsets[id], ids.data() + offsets[id + 1]};
+  }
+
+  size_t getNodeCount() const {
+    return offsets.size() - 1;
+  }
+
+  void addRow(Id id) {
+    ids.push_back(id);
+    offsets.push_back(ids.size());
+  }
+};
+
+// Layer assignment strategies: the longest path from the sources (ASAP) puts
+// every source into the first layer, the longest path to the sinks (ALAP)
+// puts every sink into the last one, the network simplex (NetworkSimplex)
+// minimizes the total edge span and thus the number of the dummy nodes,
+// the Coffman-Graham algorithm (CoffmanGraham) bounds the layer width
+enum class Layering {
+  ASAP,
+  ALAP,
+  NetworkSimplex,
+  CoffmanGraham
+};
+
+// Cycle breaking strategies: the greedy feedback arc set heuristic over the
+// whole net (FAS) or cutting the edges leaving the DFF outputs first and
+// running the heuristic only over the remaining combinational loops (DFF)
+enum class CycleBreaking {
+  FAS,
+  DFF
+};
+
+// The statistics of the layer assignment
+struct LayeringStats {
+  // The dummy nodes inserted into the edges spanning several layers
+  size_t dummyCount = 0;
+  // The network simplex layering only: the dummy nodes of the longest path
+  // ranking it starts from and the number of the pivots
+  size_t initialDummyCount = 0;
+  size_t iterationCount = 0;
 };
 
 struct Net {
-  using Id = TreeNode::Id;
+  using Id = NodeId;
 
 private:
-  std::vector<TreeNode> nodes;
-  std::vector<TreeNode::Id> sources = {};
-  std::vector<TreeNode::Id> sinks = {};
+  NodeStore nodes = {};
+  // Names of the nodes added by addNode, the dummy nodes have no names
+  NameArena names = {};
+  Adjacency succ = {};
+  Adjacency pred = {};
+  // Edges linked while the net is being built
+  std::vector<std::pair<Id, Id>> linkedEdges = {};
+  bool adjacencyBuilt = false;
+  std::vector<Id> sources = {};
+  std::vector<Id> sinks = {};
   bool sourcesCalculated = false;
   bool sinksCalculated = false;
 
@@ -39,23 +149,90 @@ public:
   const std::vector<Id> &getSources();
   const std::vector<Id> &getSinks();
 
-  const std::vector<Id> &getSuccessors(Id id) const;
-  const std::vector<Id> &getPredecessors(Id id) const;
+  Span<const Id> getSuccessors(Id id) const;
+  Span<const Id> getPredecessors(Id id) const;
+
+  // The successors and predecessors may be reordered but not replaced
+  Span<Id> getSuccessors(Id id);
+  Span<Id> getPredecessors(Id id);
+
+  size_t getNodeCount() const {
+    return nodes.size();
+  }
+
+  Id addNode(std::string_view name = {});
+  void linkNodes(Id src, Id dst);
+  void markDff(Id id);
+
+  // Freezing the linked edges into the adjacency arrays. It must be called
+  // once the net is read, no nodes and edges can be added afterwards
+  void buildAdjacency();
+
+  bool hasNode(Id id) const {
+    return id < nodes.size();
+  }
+
+  const NameArena &getNames() const {
+    return names;
+  }
+
+  std::string_view getName(Id id) const {
+    return id < names.size() ? names.get(id) : std::string_view();
+  }
+
+  int getLayer(Id id) const {
+    return nodes.layers[id];
+  }
 
-  Id addNode();
+  int getNumber(Id id) const {
+    return nodes.numbers[id];
+  }
 
-  TreeNode *getNode(Id id) {
-    const Net &net = *this;
-    return const_cast<TreeNode *>(net.getNode(id));
+  void setNumber(Id id, int number) {
+    nodes.numbers[id] = number;
   }
 
-  const TreeNode *getNode(Id id) const;
+  float getBarycentricValue(Id id) const {
+    return nodes.barycentricValues[id];
+  }
 
-  void assignLayers();
+  void setBarycentricValue(Id id, float value) {
+    nodes.barycentricValues[id] = value;
+  }
+
+  bool isDummy(Id id) const {
+    return nodes.dummies[id];
+  }
+
+  bool isDff(Id id) const {
+    return nodes.dffs[id];
+  }
+
+  // The index of the strongly connected component of every node, the
+  // components are numbered in the reverse topological order
+  size_t getStronglyConnectedComponents(
+      std::vector<uint32_t> &components) const;
+
+  // The maximum layer width is only used by the Coffman-Graham layering,
+  // 0 stands for the square root of the node count
+  LayeringStats assignLayers(
+      Layering layering = Layering::ASAP,
+      CycleBreaking cycleBreaking = CycleBreaking::FAS,
+      size_t maxLayerWidth = 0);
   void netTreeNodesToNormalizedElements(
       std::vector<NormalizedElement> &normalizedElements);
 
-  std::vector<std::vector<TreeNode::Id>> getNodesByLayer();
+  std::vector<std::vector<Id>> getNodesByLayer();
+
+  // The snapshots store the node and adjacency arrays as they are
+  friend bool saveSnapshot(
+      const char *filename,
+      const Net &net,
+      const std::vector<NormalizedElement> &normalizedElements);
+  friend bool loadSnapshot(
+      const char *filename,
+      Net &net,
+      std::vector<NormalizedElement> &normalizedElements);
 };
 
 #endif // LAYOUT_H_
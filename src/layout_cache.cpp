@@ -0,0 +1,205 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "layout_cache.h"
+
+#include "mapped_file.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char *const EntryExtension = ".lsvsnap";
+// The entries are written to temporary files first. A run stopped before the
+// rename leaves its file behind, older files than this are taken for such
+const char *const TemporaryExtension = ".tmp";
+constexpr std::chrono::hours StaleTemporaryAge{1};
+
+uint64_t mixWord(uint64_t word) {
+  word *= 0xbf58476d1ce4e5b9ull;
+  return word ^ (word >> 31);
+}
+
+// A non-cryptographic hash reading the data by 8 bytes
+uint64_t hashBytes(std::string_view data, uint64_t hash) {
+  constexpr uint64_t Multiplier = 0x9e3779b97f4a7c15ull;
+
+  hash ^= data.size() * Multiplier;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, data.data() + i, sizeof(word));
+    hash = ((hash << 27 | hash >> 37) ^ mixWord(word)) * Multiplier;
+  }
+  uint64_t tail = 0;
+  if (i != data.size()) {
+    std::memcpy(&tail, data.data() + i, data.size() - i);
+  }
+  hash = ((hash << 27 | hash >> 37) ^ mixWord(tail)) * Multiplier;
+  return hash ^ (hash >> 32);
+}
+
+} // end namespace
+
+fs::path LayoutCache::getDefaultDirectory() {
+  if (const char *directory = std::getenv("LSVIS_CACHE_DIR")) {
+    return directory;
+  }
+  if (const char *directory = std::getenv("XDG_CACHE_HOME")) {
+    return fs::path(directory) / "lsvis";
+  }
+  if (const char *home = std::getenv("HOME")) {
+    return fs::path(home) / ".cache" / "lsvis";
+  }
+  return {};
+}
+
+bool LayoutCache::makeKey(
+    const char *filename, std::string_view parameters, std::string &key) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    return false;
+  }
+
+  uint64_t hash =
+      hashBytes(parameters, uint64_t{LayoutVersion} << 32 | SnapshotVersion);
+  hash = hashBytes(file.getData(), hash);
+
+  char digits[17];
+  for (int i = 15; i >= 0; i--) {
+    digits[i] = "0123456789abcdef"[hash & 0xf];
+    hash >>= 4;
+  }
+  digits[16] = '\0';
+  key = digits;
+  return true;
+}
+
+fs::path LayoutCache::getEntryPath(const std::string &key) const {
+  return directory / (key + EntryExtension);
+}
+
+bool LayoutCache::load(
+    const std::string &key,
+    Net &net,
+    std::vector<NormalizedElement> &normalizedElements) const {
+  if (directory.empty()) {
+    return false;
+  }
+  const fs::path path = getEntryPath(key);
+  std::error_code error;
+  if (!fs::is_regular_file(path, error)) {
+    return false;
+  }
+  if (!loadSnapshot(path.string().c_str(), net, normalizedElements)) {
+    fs::remove(path, error);
+    return false;
+  }
+  // The modification time orders the entries for the eviction
+  fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+  return true;
+}
+
+bool LayoutCache::store(
+    const std::string &key,
+    const Net &net,
+    const std::vector<NormalizedElement> &normalizedElements) const {
+  if (directory.empty()) {
+    return false;
+  }
+  std::error_code error;
+  fs::create_directories(directory, error);
+  if (error) {
+    std::cerr << directory.string() << ": cannot create the cache directory"
+              << std::endl;
+    return false;
+  }
+
+  // Writing to a temporary file first, so that a concurrent run never sees
+  // an incomplete entry
+  const fs::path path = getEntryPath(key);
+  fs::path temporaryPath = path;
+  temporaryPath += "." + std::to_string(std::random_device()()) + TemporaryExtension;
+  if (!saveSnapshot(temporaryPath.string().c_str(), net, normalizedElements)) {
+    fs::remove(temporaryPath, error);
+    return false;
+  }
+  fs::rename(temporaryPath, path, error);
+  if (error) {
+    fs::remove(temporaryPath, error);
+    return false;
+  }
+
+  evict();
+  return true;
+}
+
+void LayoutCache::clear() const {
+  std::error_code error;
+  for (const fs::directory_entry &entry : fs::directory_iterator(directory, error)) {
+    if (entry.path().extension() == EntryExtension ||
+        entry.path().extension() == TemporaryExtension) {
+      fs::remove(entry.path(), error);
+    }
+  }
+}
+
+void LayoutCache::evict() const {
+  struct Entry {
+    fs::path path;
+    fs::file_time_type time;
+    uint64_t size;
+  };
+
+  std::vector<Entry> entries;
+  uint64_t totalSize = 0;
+  std::error_code error;
+  const fs::file_time_type staleTime =
+      fs::file_time_type::clock::now() - StaleTemporaryAge;
+  for (const fs::directory_entry &entry : fs::directory_iterator(directory, error)) {
+    if (entry.path().extension() == TemporaryExtension) {
+      // The newer temporary files may still be written by other runs
+      if (entry.last_write_time(error) < staleTime && !error) {
+        fs::remove(entry.path(), error);
+      }
+      continue;
+    }
+    if (entry.path().extension() != EntryExtension) {
+      continue;
+    }
+    const uint64_t size = entry.file_size(error);
+    const fs::file_time_type time = entry.last_write_time(error);
+    if (!error) {
+      entries.push_back({entry.path(), time, size});
+      totalSize += size;
+    }
+  }
+
+  // Removing the least recently used entries first
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &lhs, const Entry &rhs) {
+    return lhs.time < rhs.time;
+  });
+  for (const Entry &entry : entries) {
+    if (totalSize <= maxSize) {
+      break;
+    }
+    if (fs::remove(entry.path, error)) {
+      totalSize -= entry.size;
+    }
+  }
+}
@@ -0,0 +1,66 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LAYOUT_CACHE_H_
+#define LAYOUT_CACHE_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "layout.h"
+#include "main.h"
+
+// An on-disk cache of the laid out nets. The entries are snapshots named by
+// a hash of the input bytes and the layout parameters, the least recently
+// used entries are evicted once the cache grows over its size limit.
+class LayoutCache {
+  std::filesystem::path directory;
+  uint64_t maxSize;
+
+public:
+  static constexpr uint64_t DefaultMaxSize = uint64_t{512} << 20;
+  // Incremented whenever the same input laid out with the same parameters
+  // gets a different layout, so that the older entries are not reused
+  static constexpr uint32_t LayoutVersion = 4;
+
+  LayoutCache(std::filesystem::path directory, uint64_t maxSize)
+      : directory(std::move(directory)), maxSize(maxSize) {}
+
+  // $LSVIS_CACHE_DIR, $XDG_CACHE_HOME/lsvis or ~/.cache/lsvis (empty if
+  // neither is set)
+  static std::filesystem::path getDefaultDirectory();
+
+  // Hashing the input file together with the parameters of the layout and
+  // the layout and snapshot versions
+  static bool makeKey(
+      const char *filename, std::string_view parameters, std::string &key);
+
+  bool load(
+      const std::string &key,
+      Net &net,
+      std::vector<NormalizedElement> &normalizedElements) const;
+
+  bool store(
+      const std::string &key,
+      const Net &net,
+      const std::vector<NormalizedElement> &normalizedElements) const;
+
+  // Removing every cache entry and every temporary file
+  void clear() const;
+
+private:
+  std::filesystem::path getEntryPath(const std::string &key) const;
+  // Removing the least recently used entries over the size limit and the
+  // stale temporary files
+  void evict() const;
+};
+
+#endif // LAYOUT_CACHE_H_
@@ -9,22 +9,30 @@
 #define SDL_MAIN_HANDLED
 #include "pugixml.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
 #include <vector>
 #include <iostream>
 #include <string>
 
-#include <fstream>
 #include "layout.h"
+#include "layout_cache.h"
 #include "netfmt_bench.h"
 #include "main.h"
 #include "minimization.h"
+#include "parallel.h"
+#include "snapshot.h"
 
 enum StatusCode {
   SUCCESS = 0,
   FILENAME_NOT_PROVIDED,
   PARSER_FAILURE,
   SDL_INIT_FAILURE,
-  BENCH_READER_ERROR
+  BENCH_READER_ERROR,
+  SNAPSHOT_ERROR,
+  INVALID_OPTION
 };
 
 const char *statusMessages[] = {
@@ -34,6 +42,35 @@ const char *statusMessages[] = {
     "SDL could not be initialized\n"
 };
 
+const char *const usageMessage =
+    "Usage: main <file.bench | snapshot> [options]\n"
+    "Output:\n"
+    "  --default              print every element and connection\n"
+    "  --compact              print the numbers of elements and connections\n"
+    "  --save-snapshot FILE   save the laid out net as a snapshot\n"
+    "Layering:\n"
+    "  --asap                 longest path from the sources (default)\n"
+    "  --alap                 longest path to the sinks\n"
+    "  --network-simplex      minimum total edge span\n"
+    "  --coffman-graham       bounded layer width\n"
+    "  --max-width N          Coffman-Graham layer width (default sqrt of nodes)\n"
+    "  --cut-dff              cut the DFF outputs before breaking the cycles\n"
+    "  --layering-stats       print the dummy node counts of the layering\n"
+    "Crossing minimization:\n"
+    "  --median               median ordering heuristic\n"
+    "  --weighted-median      weighted median ordering heuristic\n"
+    "  --restarts N           N attempts, all but the first from random orders\n"
+    "  --seed S               seed of the random orders\n"
+    "  --max-sweeps N         sweeps per attempt\n"
+    "  --time-budget MS       time of the whole minimization\n"
+    "  --refine MS            greedy switch and sifting of the best order\n"
+    "  --progress             print every sweep\n"
+    "Other:\n"
+    "  --threads N            worker threads (default: hardware threads)\n"
+    "  --no-cache             neither read nor write the layout cache\n"
+    "  --clear-cache          remove the cached layouts first\n"
+    "  --cache-size MB        cache size limit (default 512)\n";
+
 const char *const parserElementId = "e_id";
 const char *const parserConnetionId = "c_id";
 const char *const parserX = "x";
@@ -48,6 +85,26 @@ const float mouseWheelScalingFactor = 0.1f;
 
 const std::string printCompactMode = "--compact";
 const std::string printDefaultMode = "--default";
+const std::string layeringAsapMode = "--asap";
+const std::string layeringAlapMode = "--alap";
+const std::string layeringNetworkSimplexMode = "--network-simplex";
+const std::string layeringCoffmanGrahamMode = "--coffman-graham";
+const std::string maxLayerWidthOption = "--max-width";
+const std::string cutDffMode = "--cut-dff";
+const std::string layeringStatsOption = "--layering-stats";
+const std::string threadsOption = "--threads";
+const std::string restartsOption = "--restarts";
+const std::string seedOption = "--seed";
+const std::string refineOption = "--refine";
+const std::string maxSweepsOption = "--max-sweeps";
+const std::string medianMode = "--median";
+const std::string weightedMedianMode = "--weighted-median";
+const std::string timeBudgetOption = "--time-budget";
+const std::string progressOption = "--progress";
+const std::string saveSnapshotOption = "--save-snapshot";
+const std::string noCacheOption = "--no-cache";
+const std::string clearCacheOption = "--clear-cache";
+const std::string cacheSizeOption = "--cache-size";
 
 float normalizedToScreenX(const float nX, const int screenW) {
   return nX * screenW;
@@ -262,6 +319,48 @@ void moveViewport(
   }
 }
 
+std::string getLayeringName(Layering layering) {
+  switch (layering) {
+  case Layering::ASAP:
+    return "asap";
+  case Layering::ALAP:
+    return "alap";
+  case Layering::NetworkSimplex:
+    return "network-simplex";
+  case Layering::CoffmanGraham:
+    return "coffman-graham";
+  }
+  return "";
+}
+
+std::string getOrderingHeuristicName(OrderingHeuristic heuristic) {
+  switch (heuristic) {
+  case OrderingHeuristic::Barycenter:
+    return "barycenter";
+  case OrderingHeuristic::Median:
+    return "median";
+  case OrderingHeuristic::WeightedMedian:
+    return "weighted-median";
+  }
+  return "";
+}
+
+void printLayeringStats(Layering layering, const LayeringStats &stats) {
+  std::cerr << "layering: " << stats.dummyCount << " dummy nodes";
+  if (layering == Layering::NetworkSimplex) {
+    std::cerr << " (longest path: " << stats.initialDummyCount << ", "
+              << stats.iterationCount << " pivots)";
+  }
+  std::cerr << std::endl;
+}
+
+void printMinimizationProgress(const MinimizationProgress &progress) {
+  std::cout << "sweep " << progress.iteration << " of attempt "
+            << progress.attempt << ": " << progress.intersections
+            << " intersections (best " << progress.bestIntersections << "), "
+            << progress.elapsed.count() << " ms\n";
+}
+
 float scaleMouseWheel(const Sint32 mouseWheelY) {
   return 1 + mouseWheelY * mouseWheelScalingFactor;
 }
@@ -269,25 +368,146 @@ float scaleMouseWheel(const Sint32 mouseWheelY) {
 int main(int argc, char *argv[]) {
   // Parse text file
   if (argc < 2) {
-    std::cerr << statusMessages[FILENAME_NOT_PROVIDED];
+    std::cerr << statusMessages[FILENAME_NOT_PROVIDED] << usageMessage;
     return FILENAME_NOT_PROVIDED;
   }
     
-  std::string printMode = printDefaultMode;
-  if (argc >= 3) {
-    printMode = argv[2];
+  // Nothing is printed unless an output mode is given
+  std::string printMode;
+  Layering layering = Layering::ASAP;
+  CycleBreaking cycleBreaking = CycleBreaking::FAS;
+  size_t maxLayerWidth = 0;
+  bool showLayeringStats = false;
+  MinimizationOptions minimizationOptions = {};
+  bool showProgress = false;
+  const char *snapshotFilename = nullptr;
+  bool useCache = true;
+  bool clearCache = false;
+  uint64_t cacheSize = LayoutCache::DefaultMaxSize;
+  for (int i = 2; i < argc; i++) {
+    const std::string option = argv[i];
+    if (option == printDefaultMode || option == printCompactMode) {
+      printMode = option;
+    } else if (option == layeringAsapMode) {
+      layering = Layering::ASAP;
+    } else if (option == layeringAlapMode) {
+      layering = Layering::ALAP;
+    } else if (option == layeringNetworkSimplexMode) {
+      layering = Layering::NetworkSimplex;
+    } else if (option == layeringCoffmanGrahamMode) {
+      layering = Layering::CoffmanGraham;
+    } else if (option == maxLayerWidthOption && i + 1 < argc) {
+      maxLayerWidth = std::max(0, std::atoi(argv[++i]));
+    } else if (option == cutDffMode) {
+      cycleBreaking = CycleBreaking::DFF;
+    } else if (option == layeringStatsOption) {
+      showLayeringStats = true;
+    } else if (option == threadsOption && i + 1 < argc) {
+      WorkerPool::setThreadCount(std::max(0, std::atoi(argv[++i])));
+    } else if (option == restartsOption && i + 1 < argc) {
+      minimizationOptions.attemptCount = std::max(1, std::atoi(argv[++i]));
+    } else if (option == seedOption && i + 1 < argc) {
+      minimizationOptions.seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (option == medianMode) {
+      minimizationOptions.heuristic = OrderingHeuristic::Median;
+    } else if (option == weightedMedianMode) {
+      minimizationOptions.heuristic = OrderingHeuristic::WeightedMedian;
+    } else if (option == maxSweepsOption && i + 1 < argc) {
+      minimizationOptions.maxIterations = std::max(0, std::atoi(argv[++i]));
+    } else if (option == timeBudgetOption && i + 1 < argc) {
+      // The time budget is given in milliseconds
+      minimizationOptions.timeBudget =
+          std::chrono::milliseconds(std::max(0, std::atoi(argv[++i])));
+    } else if (option == progressOption) {
+      showProgress = true;
+    } else if (option == refineOption && i + 1 < argc) {
+      // The refinement time is given in milliseconds
+      minimizationOptions.refinementTime =
+          std::chrono::milliseconds(std::max(0, std::atoi(argv[++i])));
+    } else if (option == saveSnapshotOption && i + 1 < argc) {
+      snapshotFilename = argv[++i];
+    } else if (option == noCacheOption) {
+      useCache = false;
+    } else if (option == clearCacheOption) {
+      clearCache = true;
+    } else if (option == cacheSizeOption && i + 1 < argc) {
+      // The limit is given in megabytes
+      cacheSize = uint64_t(std::max(0, std::atoi(argv[++i]))) << 20;
+    } else {
+      std::cerr << "Unknown option or missing value: " << option << "\n" << usageMessage;
+      return INVALID_OPTION;
+    }
   }
     
   Net net = {};
-  std::ifstream ifs(argv[1]);
-  if (!readNetFromBench(ifs, net)) {
-    return BENCH_READER_ERROR;
+  std::vector<NormalizedElement> normalizedElements = {};
+  if (isSnapshotFile(argv[1])) {
+    // The snapshot already holds the laid out net
+    if (!loadSnapshot(argv[1], net, normalizedElements)) {
+      return SNAPSHOT_ERROR;
+    }
+  } else {
+    LayoutCache cache(LayoutCache::getDefaultDirectory(), cacheSize);
+    if (clearCache) {
+      cache.clear();
+    }
+
+    // The key covers every option affecting the layout
+    std::string parameters = "layering=" + getLayeringName(layering);
+    if (layering == Layering::CoffmanGraham) {
+      parameters += ";max-width=" + std::to_string(maxLayerWidth);
+    }
+    if (cycleBreaking == CycleBreaking::DFF) {
+      parameters += ";cut-dff";
+    }
+    if (minimizationOptions.attemptCount > 1) {
+      parameters += ";restarts=" + std::to_string(minimizationOptions.attemptCount) +
+                    ";seed=" + std::to_string(minimizationOptions.seed);
+    }
+    if (minimizationOptions.heuristic != OrderingHeuristic::Barycenter) {
+      parameters += ";heuristic=" + getOrderingHeuristicName(minimizationOptions.heuristic);
+    }
+    if (minimizationOptions.maxIterations > 0) {
+      parameters += ";max-sweeps=" + std::to_string(minimizationOptions.maxIterations);
+    }
+    if (minimizationOptions.timeBudget.count() > 0) {
+      parameters += ";time-budget=" + std::to_string(minimizationOptions.timeBudget.count());
+    }
+    if (minimizationOptions.refinementTime.count() > 0) {
+      parameters += ";refine=" + std::to_string(minimizationOptions.refinementTime.count());
+    }
+    std::string cacheKey;
+    if (!useCache || !LayoutCache::makeKey(argv[1], parameters, cacheKey) ||
+        !cache.load(cacheKey, net, normalizedElements)) {
+      if (!readNetFromBenchFile(argv[1], net)) {
+        return BENCH_READER_ERROR;
+      }
+
+      const LayeringStats layeringStats =
+          net.assignLayers(layering, cycleBreaking, maxLayerWidth);
+      if (showLayeringStats) {
+        printLayeringStats(layering, layeringStats);
+      }
+      // The sweeps are only reported on request or when they are limited
+      if (showProgress || minimizationOptions.maxIterations > 0 ||
+          minimizationOptions.timeBudget.count() > 0) {
+        minimizationOptions.progress = printMinimizationProgress;
+      }
+      minimizeIntersections(net, minimizationOptions);
+      net.netTreeNodesToNormalizedElements(normalizedElements);
+
+      if (useCache && !cacheKey.empty()) {
+        cache.store(cacheKey, net, normalizedElements);
+      }
+    }
   }
 
-  net.assignLayers();
-  minimizeIntersections(net);
-  std::vector<NormalizedElement> normalizedElements = {};
-  net.netTreeNodesToNormalizedElements(normalizedElements);
+  if (snapshotFilename &&
+      !saveSnapshot(snapshotFilename, net, normalizedElements)) {
+    return SNAPSHOT_ERROR;
+  }
+
+  print(printMode, normalizedElements);
     
   // Prepare draw data and draw
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
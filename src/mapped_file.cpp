@@ -0,0 +1,82 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "mapped_file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+void MappedFile::close() {
+#ifdef MAPPED_FILE_MMAP
+  if (isMapped) {
+    munmap(const_cast<char *>(data), size);
+  }
+#endif
+  buffer.clear();
+  buffer.shrink_to_fit();
+  data = nullptr;
+  size = 0;
+  isMapped = false;
+}
+
+bool MappedFile::open(const char *filename) {
+  close();
+
+#ifdef MAPPED_FILE_MMAP
+  int fd = ::open(filename, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  // Empty files cannot be mapped
+  if (status.st_size > 0) {
+    void *address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      ::close(fd);
+      return false;
+    }
+    madvise(address, status.st_size, MADV_SEQUENTIAL);
+
+    data = static_cast<const char *>(address);
+    size = status.st_size;
+    isMapped = true;
+  }
+  ::close(fd);
+  return true;
+#else
+  std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+  if (!ifs) {
+    return false;
+  }
+  buffer.resize(static_cast<size_t>(ifs.tellg()));
+  ifs.seekg(0);
+  if (!ifs.read(buffer.data(), buffer.size())) {
+    return false;
+  }
+  data = buffer.data();
+  size = buffer.size();
+  return true;
+#endif
+}
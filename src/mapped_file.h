@@ -0,0 +1,38 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// A read-only view of a whole file. The file is mapped into memory where
+// mmap is available and read into a buffer otherwise
+class MappedFile {
+  const char *data = nullptr;
+  size_t size = 0;
+  std::vector<char> buffer = {};
+  bool isMapped = false;
+
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile();
+
+  bool open(const char *filename);
+  void close();
+
+  std::string_view getData() const {
+    return {data, size};
+  }
+};
+
+#endif // MAPPED_FILE_H_
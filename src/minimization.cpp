@@ -8,278 +8,877 @@
 
 #include "minimization.h"
 #include "layout.h"
+#include "parallel.h"
 
 #include <vector>
 #include <algorithm>
-
-typedef std::pair<TreeNode *, TreeNode *> Edge;
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <utility>
+
+// The layers narrower than this are swept serially
+constexpr size_t MinParallelLayerWidth = 2048;
+// The pairwise crossing numbers are precomputed for the sifting of the
+// layers up to this width, the wider layers only get the greedy switch
+constexpr size_t MaxSiftingLayerWidth = 2048;
+
+// The limited sweeps also stop after this many sweeps in a row without
+// reducing the crossings, the orders tend to cycle by then
+constexpr size_t MaxSweepsWithoutImprovement = 10;
+
+// The ports of the nodes with up to this many edges on a side are sorted by
+// insertion
+constexpr size_t MaxInsertionSortPorts = 16;
+
+using Clock = std::chrono::steady_clock;
 
 namespace {
+  // The edges between the neighbouring layers in flat arrays: the edges of
+  // the i-th layer pair are [offsets[i], offsets[i + 1]), their first ends
+  // are in the i-th layer (or the next one for the flat edges) and their
+  // second ends are in the next layer
+  struct LayerPairEdges {
+    std::vector<uint32_t> offsets = {0};
+    std::vector<Net::Id> firsts;
+    std::vector<Net::Id> seconds;
+
+    size_t getPairCount() const {
+      return offsets.size() - 1;
+    }
+
+    void add(Net::Id first, Net::Id second) {
+      firsts.push_back(first);
+      seconds.push_back(second);
+    }
+
+    void closePair() {
+      offsets.push_back(firsts.size());
+    }
+  };
+
+  // The sorted positions of the neighbours of the nodes of a layer in the
+  // previous and in the next layer. The ranges of the k-th node of the layer
+  // are [offsets[2k], offsets[2k + 1]) and [offsets[2k + 1], offsets[2k + 2])
+  struct LayerNeighbours {
+    std::vector<uint32_t> offsets;
+    std::vector<int> positions;
+    // The crossings of the edges of the k-th and the l-th node with the k-th
+    // node on the left are crossings[k * width + l] if precomputed
+    std::vector<uint32_t> crossings;
+    size_t width = 0;
+
+    void build(const Net &net,
+               const std::vector<int> &numbers,
+               const std::vector<Net::Id> &layer);
+    std::pair<uint32_t, uint32_t> countCrossings(size_t k, size_t l) const;
+    bool precomputeCrossings(Clock::time_point deadline);
+
+    // The crossings of the edges of the k-th and the l-th node, the k-th node
+    // is on the left
+    uint32_t getCrossings(size_t k, size_t l) const {
+      return crossings.empty() ? countCrossings(k, l).first
+                               : crossings[k * width + l];
+    }
+  };
+
+  // The buffers of the crossing counting reused over the layer pairs
+  struct CrossCountingBuffers {
+    std::vector<uint32_t> counts;
+    std::vector<Net::Id> firsts;
+    std::vector<Net::Id> seconds;
+    std::vector<int> fenwickTree;
+  };
+
   struct AdditionalNetFeatures {
 //  AdditionalNetFeatures - a structure containing descriptions of vertices by layers,
 //  temporal distribution by vertices, and edges
-    std::vector<std::vector<TreeNode::Id>> nodesByLayer;
-    std::vector<std::vector<TreeNode::Id>> tempNodesByLayer;
-    std::vector<std::vector<Edge>> netEdges;
-    int intersections = -1;
-    std::vector<int> accTree;
+    std::vector<std::vector<Net::Id>> nodesByLayer;
+    std::vector<std::vector<Net::Id>> tempNodesByLayer;
+    LayerPairEdges netEdges;
+    // The numbers of the nodes in their layers and their barycentric values,
+    // the net itself is only read while the layers are swept
+    std::vector<int> numbers;
+    std::vector<float> barycentricValues;
+    // The crossings of the best order found so far and of the order after
+    // the last sweep
+    int64_t intersections = -1;
+    int64_t sweepIntersections = -1;
+    // The crossings between the i-th and the next layer
+    std::vector<int64_t> crossCounts;
+
+    // Every layer sweep step gets a stamp. The layer orders are tracked by
+    // the stamps of their last changes, so that the crossings are only
+    // recounted and the layers are only copied and resorted after changes
+    int64_t stamp = 0;
+    int64_t countStamp = -1;
+    int64_t saveStamp = -1;
+    std::vector<int64_t> changeStamps;
+    // The stamps of the last forward and backward sorts of the layers
+    std::vector<int64_t> forwardSortStamps;
+    std::vector<int64_t> backwardSortStamps;
+
+    bool isChangedSince(size_t layer, int64_t since) const {
+      return changeStamps[layer] > since;
+    }
 
-    void layerSweepAlgorithm(Net &net);
+    bool greedySwitch(const LayerNeighbours &neighbours,
+                      std::vector<uint32_t> &slots,
+                      Clock::time_point deadline);
+    bool sift(const LayerNeighbours &neighbours,
+              std::vector<uint32_t> &slots,
+              Clock::time_point deadline);
+    void refine(const Net &net, Clock::time_point deadline);
+    void init(const std::vector<std::vector<Net::Id>> &layers,
+              const LayerPairEdges &edges);
+    void shuffleLayers(uint64_t seed, size_t attempt);
+    template <OrderingHeuristic Heuristic>
+    bool layerSweep(const Net &net, size_t layer, int direction);
+    template <OrderingHeuristic Heuristic>
+    void layerSweepAlgorithm(const Net &net,
+                             size_t maxIterations,
+                             Clock::time_point deadline,
+                             const std::function<void(size_t)> &onIteration);
     void setEdgesToOptimalCondition(Net &net);
-    int crossCounting();
+    int64_t crossCountingForLayer(size_t i, CrossCountingBuffers &buffers);
+    int64_t crossCounting();
   };
 }
 
-float forwardRankDefinition(TreeNode &node, int nodeIndex, int portIndex) {
-  return nodeIndex + portIndex / (node.succ.size() + 1);
+float forwardRankDefinition(const Net &net, Net::Id id, int nodeIndex, int portIndex) {
+  return nodeIndex + float(portIndex) / (net.getSuccessors(id).size() + 1);
 }
 
-float backwardRankDefinition(TreeNode &node, int nodeIndex, int portIndex) {
+float backwardRankDefinition(const Net &net, Net::Id id, int nodeIndex, int portIndex) {
+  const size_t succCount = net.getSuccessors(id).size();
+  const size_t predCount = net.getPredecessors(id).size();
   int portOrderValue;
-  int maxPortIndex = node.pred.size() + node.succ.size();
+  int maxPortIndex = predCount + succCount;
   if (portIndex <= maxPortIndex) {
     portOrderValue = maxPortIndex - portIndex + 1;
   } else {
-    portOrderValue = maxPortIndex + node.succ.size() - portIndex + 1;
+    portOrderValue = maxPortIndex + succCount - portIndex + 1;
   }
-  return nodeIndex + portOrderValue / (node.pred.size() + 1);
+  return nodeIndex + float(portOrderValue) / (predCount + 1);
 }
 
-void sortNodes(Net &net, std::vector<TreeNode::Id> &layer) {
-  std::sort(layer.begin(), layer.end(), [&net](auto x, auto y) -> bool {
-    return net.getNode(x)->barycentricValue < net.getNode(y)->barycentricValue;
-  });
+bool sortNodes(std::vector<int> &numbers,
+               const std::vector<float> &barycentricValues,
+               std::vector<Net::Id> &layer) {
+  // The nodes of equal values keep their order, so the order is total and
+  // the result is the same for any number of threads
+  auto isLess = [&](auto x, auto y) -> bool {
+    if (barycentricValues[x] != barycentricValues[y]) {
+      return barycentricValues[x] < barycentricValues[y];
+    }
+    return numbers[x] < numbers[y];
+  };
+  parallelSort(layer.begin(), layer.end(), MinParallelLayerWidth, isLess);
+  bool isChanged = false;
   for (size_t i = 0; i < layer.size(); ++i) {
-    net.getNode(layer[i])->number = i;
+    isChanged |= numbers[layer[i]] != static_cast<int>(i);
+    numbers[layer[i]] = i;
   }
+  return isChanged;
 }
 
-int getAmountOfLayers(std::vector<TreeNode> &nodes) {
+int getAmountOfLayers(const std::vector<int> &layers) {
   int amountOfLayers = 0;
-  for (size_t i = 0; i < nodes.size(); ++i) {
-    if (nodes[i].layer > amountOfLayers)
-      amountOfLayers = nodes[i].layer;
+  for (size_t i = 0; i < layers.size(); ++i) {
+    if (layers[i] > amountOfLayers)
+      amountOfLayers = layers[i];
   }
   return amountOfLayers;
 }
 
-std::vector<std::vector<TreeNode::Id>> Net::getNodesByLayer() {
-  int amountOfLayers = getAmountOfLayers(nodes);
-  std::vector<std::vector<TreeNode::Id>> nodesByLayer(amountOfLayers + 1);
-  for (TreeNode &node: nodes) {
-    std::vector<TreeNode::Id> &layer = nodesByLayer[node.layer];
-    layer.push_back(node.id);
-    node.number = layer.size() - 1;
+std::vector<std::vector<Net::Id>> Net::getNodesByLayer() {
+  int amountOfLayers = getAmountOfLayers(nodes.layers);
+  std::vector<std::vector<Net::Id>> nodesByLayer(amountOfLayers + 1);
+  for (Id id = 0; id < nodes.size(); ++id) {
+    std::vector<Net::Id> &layer = nodesByLayer[nodes.layers[id]];
+    layer.push_back(id);
+    nodes.numbers[id] = layer.size() - 1;
   }
   return nodesByLayer;
 }
 
-void edgesByLayers(Net &net,
-                   std::vector<TreeNode::Id> &vec,
-                   TreeNode *node,
-                   std::vector<Edge> &edges) {
-  for (TreeNode::Id id: vec) {
-    TreeNode *connectedNode = net.getNode(id);
-    if (connectedNode->layer > node->layer)
+void edgesByLayers(const Net &net,
+                   Span<const Net::Id> vec,
+                   Net::Id node,
+                   LayerPairEdges &edges) {
+  for (Net::Id connectedNode: vec) {
+    if (net.getLayer(connectedNode) > net.getLayer(node))
       continue;
-    edges.emplace_back(connectedNode, node);
+    edges.add(connectedNode, node);
   }
 }
 
-std::vector<std::vector<Edge>> getNetEdges(Net &net,
-                                           std::vector<std::vector<TreeNode::Id>> &tempNodesByLayer) {
-  std::vector<std::vector<Edge>> netEdges;
+LayerPairEdges getNetEdges(const Net &net,
+                           const std::vector<std::vector<Net::Id>> &tempNodesByLayer) {
+  LayerPairEdges netEdges;
   for (size_t i = 1; i < tempNodesByLayer.size(); ++i) {
-    std::vector<Edge> edges;
     for (size_t j = 0; j < tempNodesByLayer[i].size(); ++j) {
-      TreeNode *node = net.getNode(tempNodesByLayer[i][j]);
-      edgesByLayers(net, node->pred, node, edges);
-      edgesByLayers(net, node->succ, node, edges);
+      Net::Id node = tempNodesByLayer[i][j];
+      edgesByLayers(net, net.getPredecessors(node), node, netEdges);
+      edgesByLayers(net, net.getSuccessors(node), node, netEdges);
     }
-    netEdges.push_back(std::move(edges));
+    netEdges.closePair();
   }
   return netEdges;
 }
 
-bool lexicographicSortCondition(const Edge &edge1, const Edge &edge2) {
-  if (edge1.first->number == edge2.first->number) {
-    return edge1.second->number < edge2.second->number;
-  } else {
-    return edge1.first->number < edge2.first->number;
+// Stable counting sort of count edges by the numbers of their key ends,
+// which are below keyCount. The ends are moved to the sorted arrays
+void countingSortEdges(const std::vector<int> &numbers,
+                       size_t count,
+                       const Net::Id *keyIds,
+                       const Net::Id *otherIds,
+                       Net::Id *sortedKeyIds,
+                       Net::Id *sortedOtherIds,
+                       size_t keyCount,
+                       std::vector<uint32_t> &counts) {
+  counts.assign(keyCount + 1, 0);
+  for (size_t k = 0; k < count; ++k) {
+    ++counts[numbers[keyIds[k]] + 1];
+  }
+  for (size_t k = 0; k < keyCount; ++k) {
+    counts[k + 1] += counts[k];
+  }
+  for (size_t k = 0; k < count; ++k) {
+    const uint32_t index = counts[numbers[keyIds[k]]]++;
+    sortedKeyIds[index] = keyIds[k];
+    sortedOtherIds[index] = otherIds[k];
   }
 }
 
-int nearestPow2(int x) {
-  --x;
-  x |= x >> 1;
-  x |= x >> 2;
-  x |= x >> 4;
-  x |= x >> 8;
-  x |= x >> 16;
-  return ++x;
+// Counting the crossings between the i-th and the next layer: the edges are
+// sorted lexicographically by the numbers of their ends with two counting
+// sort passes, then every edge crosses the edges added before it and ending
+// further, which are counted by the Fenwick tree over the next layer
+int64_t AdditionalNetFeatures::crossCountingForLayer(
+    size_t i, CrossCountingBuffers &buffers) {
+  const size_t nextLayerSize = tempNodesByLayer[i + 1].size();
+  const size_t keyCount = std::max(tempNodesByLayer[i].size(), nextLayerSize);
+  const size_t count = netEdges.offsets[i + 1] - netEdges.offsets[i];
+  Net::Id *firsts = netEdges.firsts.data() + netEdges.offsets[i];
+  Net::Id *seconds = netEdges.seconds.data() + netEdges.offsets[i];
+  buffers.firsts.resize(count);
+  buffers.seconds.resize(count);
+  countingSortEdges(numbers, count, seconds, firsts, buffers.seconds.data(),
+                    buffers.firsts.data(), keyCount, buffers.counts);
+  countingSortEdges(numbers, count, buffers.firsts.data(), buffers.seconds.data(),
+                    firsts, seconds, keyCount, buffers.counts);
+
+  std::vector<int> &fenwickTree = buffers.fenwickTree;
+  fenwickTree.assign(nextLayerSize + 1, 0);
+  int64_t crossCount = 0;
+  for (size_t k = 0; k < count; k++) {
+    // The edges added before and ending at most at this position
+    const int position = numbers[seconds[k]] + 1;
+    int64_t notFurther = 0;
+    for (int index = position; index > 0; index &= index - 1) {
+      notFurther += fenwickTree[index];
+    }
+    crossCount += k - notFurther;
+    for (size_t index = position; index <= nextLayerSize; index += index & -index) {
+      ++fenwickTree[index];
+    }
+  }
+  return crossCount;
 }
 
-int AdditionalNetFeatures::crossCounting() {
+int64_t AdditionalNetFeatures::crossCounting() {
 //  crossCounting - graph edge intersection counting algorithm
 //  link: https://jgaa.info/accepted/2004/BarthMutzelJuenger2004.8.2.pdf
 //  Author: Wilhelm Barth, Michael J¨unger, and Petra Mutzel.
-  int crossCount = 0;
-  for (size_t i = 0; i < netEdges.size(); ++i) {
-    std::sort(netEdges[i].begin(), netEdges[i].end(), lexicographicSortCondition);
-
-    const int numLeaves = nearestPow2(netEdges[i].size());
-    const int firstLeafIndex = numLeaves - 1;
-    const int treeSize = numLeaves * 2 - 1;
-
-    accTree.clear();
-    accTree.resize(treeSize, 0);
-
-    for (size_t k = 0; k < netEdges[i].size(); k++) {
-      int index = netEdges[i][k].second -> number + firstLeafIndex;
-      ++accTree[index];
-      while (index > 0) {
-        if (index % 2)
-          crossCount += accTree[index + 1];
-        index = (index - 1) / 2;
-        ++accTree[index];
+//  The layer pairs are independent, so they are counted in parallel, every
+//  range of the pairs with its own buffers
+//  Only the pairs with a layer reordered since the last counting are counted
+  crossCounts.resize(netEdges.getPairCount());
+  parallelFor(netEdges.getPairCount(), 1, [&](size_t begin, size_t end) {
+    CrossCountingBuffers buffers;
+    for (size_t i = begin; i < end; ++i) {
+      if (isChangedSince(i, countStamp) || isChangedSince(i + 1, countStamp)) {
+        crossCounts[i] = crossCountingForLayer(i, buffers);
       }
     }
+  });
+  countStamp = stamp;
+
+  int64_t crossCount = 0;
+  for (int64_t count : crossCounts) {
+    crossCount += count;
   }
   return crossCount;
 }
 
 void getBarycentricValueForPorts(Net &net,
-                                 std::vector<TreeNode::Id> &vec,
+                                 Span<Net::Id> vec,
                                  bool forwardLayerSweep,
-                                 std::vector<std::pair<float, TreeNode::Id>> &barycentricValueForPorts) {
+                                 std::vector<std::pair<float, Net::Id>> &barycentricValueForPorts) {
   for (size_t i = 0; i < vec.size(); ++i) {
-    TreeNode *node = net.getNode(vec[i]);
+    Net::Id node = vec[i];
     float bValue;
     if (forwardLayerSweep) {
-      bValue = forwardRankDefinition(*node, node->number, i);
+      bValue = forwardRankDefinition(net, node, net.getNumber(node), i);
     } else {
-      bValue = backwardRankDefinition(*node, node->number, i);
+      bValue = backwardRankDefinition(net, node, net.getNumber(node), i);
     }
-    bValue /= float(node->succ.size() + node->pred.size());
-    barycentricValueForPorts.push_back({bValue, node->id});
+    bValue /= float(net.getSuccessors(node).size() + net.getPredecessors(node).size());
+    barycentricValueForPorts.push_back({bValue, node});
   }
 }
 
-void sortPorts(Net &net, std::vector<TreeNode::Id> &vec, bool flag) {
-  std::vector<std::pair<float, TreeNode::Id>> barycentricValueForPorts;
+void sortPorts(Net &net, Span<Net::Id> vec, bool flag) {
+  if (vec.size() < 2) {
+    return;
+  }
+  // The buffer is reused by every node sorted on the thread
+  thread_local std::vector<std::pair<float, Net::Id>> barycentricValueForPorts;
+  barycentricValueForPorts.clear();
   getBarycentricValueForPorts(net, vec, flag, barycentricValueForPorts);
-  std::sort(barycentricValueForPorts.begin(), barycentricValueForPorts.end());
+  // The pairs are distinct, so both sorts give the same order
+  if (barycentricValueForPorts.size() <= MaxInsertionSortPorts) {
+    for (size_t k = 1; k < barycentricValueForPorts.size(); ++k) {
+      const std::pair<float, Net::Id> port = barycentricValueForPorts[k];
+      size_t l = k;
+      for (; l > 0 && port < barycentricValueForPorts[l - 1]; --l) {
+        barycentricValueForPorts[l] = barycentricValueForPorts[l - 1];
+      }
+      barycentricValueForPorts[l] = port;
+    }
+  } else {
+    std::sort(barycentricValueForPorts.begin(), barycentricValueForPorts.end());
+  }
   for (size_t k = 0; k < barycentricValueForPorts.size(); ++k) {
     vec[k] = barycentricValueForPorts[k].second;
   }
 }
 
-void portOrderOptimization(Net &net, std::vector<std::vector<TreeNode::Id>> &nodesByLayer) {
-  for (size_t i = 0; i < nodesByLayer.size(); ++i) {
+// Every node only reorders its own edges by the numbers of its neighbours,
+// so the layers are processed in parallel
+void portOrderOptimization(Net &net, std::vector<std::vector<Net::Id>> &nodesByLayer) {
+  WorkerPool::get().run(nodesByLayer.size(), [&](size_t i) {
     for (size_t j = 0; j < nodesByLayer[i].size(); ++j) {
-      TreeNode *node = net.getNode(nodesByLayer[i][j]);
-      sortPorts(net, node->pred, true);
-      sortPorts(net, node->succ, false);
+      Net::Id node = nodesByLayer[i][j];
+      sortPorts(net, net.getPredecessors(node), true);
+      sortPorts(net, net.getSuccessors(node), false);
+    }
+  });
+}
+
+// Calling the visitor with the positions of the neighbours of the node in
+// the fixed layer, the positions are refined by the ports of the edges
+template <typename Visitor>
+void forEachNeighbourPosition(const Net &net,
+                              const std::vector<int> &numbers,
+                              Net::Id node,
+                              int direction,
+                              Visitor &&visit) {
+  for (Span<const Net::Id> vec : {net.getPredecessors(node), net.getSuccessors(node)}) {
+    for (size_t k = 0; k < vec.size(); ++k) {
+      if (net.getLayer(vec[k]) + direction != net.getLayer(node))
+        continue;
+      int index = numbers[vec[k]];
+      if (direction == 1) {
+        visit(forwardRankDefinition(net, vec[k], index, k));
+      } else {
+        visit(backwardRankDefinition(net, vec[k], index, k));
+      }
     }
   }
 }
 
-int totalRankForFixLayer(Net &net,
-                         std::vector<TreeNode::Id> &vec,
-                         TreeNode *node,
-                         int direction,
-                         int &connectionsToAdjacentLayer) {
-  int rank = 0;
-  for (size_t k = 0; k < vec.size(); ++k) {
-    if (net.getNode(vec[k])->layer + direction != node->layer)
-      continue;
-    connectionsToAdjacentLayer += 1;
-    int index = net.getNode(vec[k])->number;
-    if (direction == 1) {
-      rank += forwardRankDefinition(*net.getNode(vec[k]), index, k);
-    } else {
-      rank += backwardRankDefinition(*net.getNode(vec[k]), index, k);
+// The median of the sorted positions. The weighted median of an even number
+// of positions leans towards the side where the positions are denser
+// (Gansner et al., "A technique for drawing directed graphs")
+template <OrderingHeuristic Heuristic>
+float getMedian(std::vector<float> &positions) {
+  const size_t middle = positions.size() / 2;
+  if constexpr (Heuristic == OrderingHeuristic::Median) {
+    std::nth_element(positions.begin(), positions.begin() + (positions.size() - 1) / 2,
+                     positions.end());
+    return positions[(positions.size() - 1) / 2];
+  } else {
+    std::sort(positions.begin(), positions.end());
+    if (positions.size() % 2 == 1) {
+      return positions[middle];
+    }
+    if (positions.size() == 2) {
+      return (positions[0] + positions[1]) / 2;
+    }
+    const float left = positions[middle - 1] - positions.front();
+    const float right = positions.back() - positions[middle];
+    if (left + right == 0) {
+      return (positions[middle - 1] + positions[middle]) / 2;
     }
+    return (positions[middle - 1] * right + positions[middle] * left) / (left + right);
   }
-  return rank;
 }
 
-void barycentricValueDefinition(Net &net, TreeNode *node, int direction) {
+// The values the layer is sorted by, the positions buffer is only used by
+// the medians
+template <OrderingHeuristic Heuristic>
+void barycentricValueDefinition(const Net &net,
+                                AdditionalNetFeatures &features,
+                                Net::Id node,
+                                int direction,
+                                std::vector<float> &positions) {
+  const std::vector<int> &numbers = features.numbers;
   int connectionsToAdjacentLayer = 0;
   float rank = 0;
-  rank += totalRankForFixLayer(net, node->pred, node, direction, connectionsToAdjacentLayer);
-  rank += totalRankForFixLayer(net, node->succ, node, direction, connectionsToAdjacentLayer);
-  node->barycentricValue = rank / connectionsToAdjacentLayer;
+  if constexpr (Heuristic == OrderingHeuristic::Barycenter) {
+    forEachNeighbourPosition(net, numbers, node, direction, [&](float position) {
+      rank += position;
+      ++connectionsToAdjacentLayer;
+    });
+  } else {
+    positions.clear();
+    forEachNeighbourPosition(net, numbers, node, direction, [&](float position) {
+      positions.push_back(position);
+    });
+    connectionsToAdjacentLayer = positions.size();
+  }
+  if (connectionsToAdjacentLayer == 0) {
+    // A node without neighbours in the fixed layer takes its own slot as the
+    // value, the NaN value would break the ordering of the sort. Keeping such
+    // nodes in their slots gave more crossings on the large nets
+    features.barycentricValues[node] = numbers[node];
+    return;
+  }
+  if constexpr (Heuristic == OrderingHeuristic::Barycenter) {
+    features.barycentricValues[node] = rank / connectionsToAdjacentLayer;
+  } else {
+    features.barycentricValues[node] = getMedian<Heuristic>(positions);
+  }
 }
 
 bool stopAlgorithm(AdditionalNetFeatures &features) {
-  int intersectionsAfterAlgorithm = features.crossCounting();
+  int64_t intersectionsAfterAlgorithm = features.crossCounting();
+  features.sweepIntersections = intersectionsAfterAlgorithm;
   if (features.intersections > intersectionsAfterAlgorithm || features.intersections == -1) {
     features.intersections = intersectionsAfterAlgorithm;
-    std::copy(
-        features.tempNodesByLayer.begin(),
-        features.tempNodesByLayer.end(),
-        features.nodesByLayer.begin());
+    for (size_t i = 0; i < features.tempNodesByLayer.size(); ++i) {
+      if (features.isChangedSince(i, features.saveStamp)) {
+        features.nodesByLayer[i] = features.tempNodesByLayer[i];
+      }
+    }
+    features.saveStamp = features.stamp;
     return false;
   } else {
     return true;
   }
 }
 
-void doLayerSweep(Net &net,
-                  std::vector<TreeNode::Id> &layer,
+template <OrderingHeuristic Heuristic>
+bool doLayerSweep(const Net &net,
+                  AdditionalNetFeatures &features,
+                  std::vector<Net::Id> &layer,
                   int direction) {
-  for (size_t j = 0; j < layer.size(); ++j) {
-    barycentricValueDefinition(net, net.getNode(layer[j]), direction);
+  // The values only depend on the fixed neighbouring layer
+  parallelFor(layer.size(), MinParallelLayerWidth, [&](size_t begin, size_t end) {
+    std::vector<float> positions;
+    for (size_t j = begin; j < end; ++j) {
+      barycentricValueDefinition<Heuristic>(net, features, layer[j], direction, positions);
+    }
+  });
+  return sortNodes(features.numbers, features.barycentricValues, layer);
+}
+
+// Sorting the layer by the fixed neighbouring layer. The sort keeps the
+// order of the equal values, so sorting again gives the same order unless
+// the layer or the neighbouring layer have changed since. The regions
+// converged locally are thus skipped without changing the result
+template <OrderingHeuristic Heuristic>
+bool AdditionalNetFeatures::layerSweep(const Net &net, size_t layer, int direction) {
+  std::vector<int64_t> &sortStamps =
+      direction > 0 ? forwardSortStamps : backwardSortStamps;
+  const int64_t sortStamp = sortStamps[layer];
+  if (!isChangedSince(layer, sortStamp) &&
+      !isChangedSince(layer - direction, sortStamp)) {
+    return false;
   }
-  sortNodes(net, layer);
+
+  ++stamp;
+  sortStamps[layer] = stamp;
+  if (doLayerSweep<Heuristic>(net, *this, tempNodesByLayer[layer], direction)) {
+    changeStamps[layer] = stamp;
+    return true;
+  }
+  return false;
 }
 
-void AdditionalNetFeatures::layerSweepAlgorithm(Net &net) {
+// Sweeping the layers forward and backward. Without limits the sweeps stop
+// once they stop reducing the crossings. With a limit on the sweeps or on
+// the time they go on until the limit, until the order no longer changes or
+// until it has not improved for a while. The best order found so far is
+// kept in nodesByLayer anyway
+template <OrderingHeuristic Heuristic>
+void AdditionalNetFeatures::layerSweepAlgorithm(
+    const Net &net,
+    size_t maxIterations,
+    Clock::time_point deadline,
+    const std::function<void(size_t)> &onIteration) {
+  const bool isLimited = maxIterations != 0 || deadline != Clock::time_point::max();
+
+  // The initial order counts as a change
+  changeStamps.assign(tempNodesByLayer.size(), 0);
+  forwardSortStamps.assign(tempNodesByLayer.size(), -1);
+  backwardSortStamps.assign(tempNodesByLayer.size(), -1);
+
   int direction = 1;
+  size_t iteration = 0;
+  size_t unchangedSweeps = 0;
+  size_t unimprovedSweeps = 0;
   while (true) {
     // forward layer sweeps: direction = 1; backwards layer sweeps direction = -1
+    bool isChanged = false;
     if (direction > 0) {
-      for (auto it = tempNodesByLayer.begin() + 1, end = tempNodesByLayer.end(); it != end; ++it) {
-        doLayerSweep(net, *it, direction);
+      for (size_t i = 1; i < tempNodesByLayer.size() && Clock::now() < deadline; ++i) {
+        isChanged |= layerSweep<Heuristic>(net, i, direction);
       }
     } else {
-      for (auto it = tempNodesByLayer.rbegin() + 1, end = tempNodesByLayer.rend(); it != end; ++it) {
-        doLayerSweep(net, *it, direction);
+      for (size_t i = tempNodesByLayer.size() - 1; i-- > 0 && Clock::now() < deadline;) {
+        isChanged |= layerSweep<Heuristic>(net, i, direction);
       }
     }
-    if (stopAlgorithm(*this))
+    const bool isImproved = !stopAlgorithm(*this);
+    onIteration(++iteration);
+
+    // Both directions are settled once two sweeps in a row change nothing
+    unchangedSweeps = isChanged ? 0 : unchangedSweeps + 1;
+    unimprovedSweeps = isImproved ? 0 : unimprovedSweeps + 1;
+    if (!isLimited ? !isImproved
+                   : iteration == maxIterations || Clock::now() >= deadline ||
+                         unchangedSweeps == 2 ||
+                         unimprovedSweeps == MaxSweepsWithoutImprovement)
       break;
     direction *= -1;
   }
 }
 
+void LayerNeighbours::build(const Net &net,
+                            const std::vector<int> &numbers,
+                            const std::vector<Net::Id> &layer) {
+  width = layer.size();
+  offsets.assign(1, 0);
+  positions.clear();
+  crossings.clear();
+  for (Net::Id node : layer) {
+    for (int direction : {-1, 1}) {
+      const size_t first = positions.size();
+      for (Span<const Net::Id> vec : {net.getPredecessors(node), net.getSuccessors(node)}) {
+        for (Net::Id connectedNode : vec) {
+          if (net.getLayer(connectedNode) == net.getLayer(node) + direction) {
+            positions.push_back(numbers[connectedNode]);
+          }
+        }
+      }
+      std::sort(positions.begin() + first, positions.end());
+      offsets.push_back(positions.size());
+    }
+  }
+}
+
+// The crossings of the edges of the k-th and the l-th node with the k-th
+// node on the left and on the right, the edges ending at the same node do
+// not cross
+std::pair<uint32_t, uint32_t> LayerNeighbours::countCrossings(
+    size_t k, size_t l) const {
+  uint32_t left = 0;
+  uint32_t right = 0;
+  for (size_t side = 0; side < 2; ++side) {
+    const int *kFirst = positions.data() + offsets[2 * k + side];
+    const int *kLast = positions.data() + offsets[2 * k + side + 1];
+    const int *lFirst = positions.data() + offsets[2 * l + side];
+    const int *lLast = positions.data() + offsets[2 * l + side + 1];
+    const int *less = lFirst;
+    const int *notGreater = lFirst;
+    for (const int *it = kFirst; it != kLast; ++it) {
+      while (less != lLast && *less < *it) {
+        ++less;
+      }
+      while (notGreater != lLast && *notGreater <= *it) {
+        ++notGreater;
+      }
+      left += less - lFirst;
+      right += lLast - notGreater;
+    }
+  }
+  return {left, right};
+}
+
+// Precomputing the crossings of every node pair, nothing is precomputed if
+// the deadline passes first
+bool LayerNeighbours::precomputeCrossings(Clock::time_point deadline) {
+  crossings.assign(width * width, 0);
+  for (size_t k = 0; k < width; ++k) {
+    if (Clock::now() >= deadline) {
+      crossings.clear();
+      return false;
+    }
+    for (size_t l = k + 1; l < width; ++l) {
+      const auto [left, right] = countCrossings(k, l);
+      crossings[k * width + l] = left;
+      crossings[l * width + k] = right;
+    }
+  }
+  return true;
+}
+
+// Swapping the neighbouring nodes while it removes crossings. The slots
+// are the indices of the nodes of the layer in the neighbours
+bool AdditionalNetFeatures::greedySwitch(const LayerNeighbours &neighbours,
+                                         std::vector<uint32_t> &slots,
+                                         Clock::time_point deadline) {
+  bool isChanged = false;
+  bool isSwitched = true;
+  while (isSwitched && Clock::now() < deadline) {
+    isSwitched = false;
+    for (size_t j = 0; j + 1 < slots.size(); ++j) {
+      if (neighbours.getCrossings(slots[j + 1], slots[j]) <
+          neighbours.getCrossings(slots[j], slots[j + 1])) {
+        std::swap(slots[j], slots[j + 1]);
+        isSwitched = true;
+      }
+    }
+    isChanged |= isSwitched;
+  }
+  return isChanged;
+}
+
+// Moving every node to the position of the fewest crossings with the other
+// nodes of the layer kept in their order
+bool AdditionalNetFeatures::sift(const LayerNeighbours &neighbours,
+                                 std::vector<uint32_t> &slots,
+                                 Clock::time_point deadline) {
+  bool isChanged = false;
+  const std::vector<uint32_t> siftedSlots = slots;
+  for (uint32_t slot : siftedSlots) {
+    if (Clock::now() >= deadline) {
+      break;
+    }
+    // Walking from the leftmost position to the right, the node stays at
+    // its position unless another one is strictly better
+    const size_t position = std::find(slots.begin(), slots.end(), slot) - slots.begin();
+    slots.erase(slots.begin() + position);
+    int64_t delta = 0;
+    int64_t bestDelta = 0;
+    size_t bestPosition = 0;
+    int64_t positionDelta = 0;
+    for (size_t j = 0; j <= slots.size(); ++j) {
+      if (j == position) {
+        positionDelta = delta;
+      }
+      if (delta < bestDelta) {
+        bestDelta = delta;
+        bestPosition = j;
+      }
+      if (j < slots.size()) {
+        delta += int64_t(neighbours.getCrossings(slots[j], slot)) -
+                 int64_t(neighbours.getCrossings(slot, slots[j]));
+      }
+    }
+    if (bestDelta >= positionDelta) {
+      bestPosition = position;
+    }
+    slots.insert(slots.begin() + bestPosition, slot);
+    isChanged |= bestPosition != position;
+  }
+  return isChanged;
+}
+
+// Refining the best order by the greedy switch and the sifting layer by
+// layer until nothing changes or the deadline. The crossings are counted
+// again at the end and the refined order is only kept if it is better
+void AdditionalNetFeatures::refine(const Net &net, Clock::time_point deadline) {
+  for (size_t i = 0; i < tempNodesByLayer.size(); ++i) {
+    if (isChangedSince(i, saveStamp)) {
+      tempNodesByLayer[i] = nodesByLayer[i];
+      for (size_t j = 0; j < tempNodesByLayer[i].size(); ++j) {
+        numbers[tempNodesByLayer[i][j]] = j;
+      }
+      changeStamps[i] = ++stamp;
+    }
+  }
+
+  LayerNeighbours neighbours;
+  std::vector<uint32_t> slots;
+  std::vector<Net::Id> layer;
+  bool isChanged = true;
+  while (isChanged && Clock::now() < deadline) {
+    isChanged = false;
+    for (size_t i = 0; i < tempNodesByLayer.size() && Clock::now() < deadline; ++i) {
+      layer = tempNodesByLayer[i];
+      neighbours.build(net, numbers, layer);
+      slots.resize(layer.size());
+      for (size_t j = 0; j < slots.size(); ++j) {
+        slots[j] = j;
+      }
+
+      bool isLayerChanged = false;
+      if (layer.size() <= MaxSiftingLayerWidth &&
+          neighbours.precomputeCrossings(deadline)) {
+        isLayerChanged |= sift(neighbours, slots, deadline);
+      }
+      isLayerChanged |= greedySwitch(neighbours, slots, deadline);
+      if (!isLayerChanged) {
+        continue;
+      }
+
+      for (size_t j = 0; j < slots.size(); ++j) {
+        tempNodesByLayer[i][j] = layer[slots[j]];
+        numbers[layer[slots[j]]] = j;
+      }
+      changeStamps[i] = ++stamp;
+      isChanged = true;
+    }
+  }
+
+  stopAlgorithm(*this);
+}
+
 void AdditionalNetFeatures::setEdgesToOptimalCondition(Net &net) {
   //fix changes after the last iteration of selection of vertex order
   for (size_t i = 0; i < nodesByLayer.size(); ++i) {
     for (size_t j = 0; j < nodesByLayer[i].size(); ++j) {
-      net.getNode(nodesByLayer[i][j])->number = j;
+      net.setNumber(nodesByLayer[i][j], j);
+    }
+  }
+}
+
+void AdditionalNetFeatures::init(
+    const std::vector<std::vector<Net::Id>> &layers,
+    const LayerPairEdges &edges) {
+  nodesByLayer = layers;
+  tempNodesByLayer = layers;
+  netEdges = edges;
+
+  size_t nodeCount = 0;
+  for (const std::vector<Net::Id> &layer : layers) {
+    nodeCount += layer.size();
+  }
+  numbers.resize(nodeCount);
+  barycentricValues.resize(nodeCount);
+  for (const std::vector<Net::Id> &layer : layers) {
+    for (size_t j = 0; j < layer.size(); ++j) {
+      numbers[layer[j]] = j;
+    }
+  }
+}
+
+// Shuffling the layers by Fisher-Yates with the generator seeded by the seed
+// and the attempt. The output of mt19937_64 is fixed by the standard unlike
+// the distributions, so the orders are the same on every platform
+void AdditionalNetFeatures::shuffleLayers(uint64_t seed, size_t attempt) {
+  std::mt19937_64 generator(seed + attempt * 0x9e3779b97f4a7c15ull);
+  for (size_t i = 0; i < tempNodesByLayer.size(); ++i) {
+    std::vector<Net::Id> &layer = tempNodesByLayer[i];
+    for (size_t j = layer.size(); j > 1; --j) {
+      std::swap(layer[j - 1], layer[generator() % j]);
+    }
+    for (size_t j = 0; j < layer.size(); ++j) {
+      numbers[layer[j]] = j;
     }
+    nodesByLayer[i] = layer;
   }
 }
 
-void minimizeIntersections(Net &net) {
+int64_t countIntersections(const Net &net) {
+  std::vector<std::vector<Net::Id>> nodesByLayer;
+  for (Net::Id id = 0; id < net.getNodeCount(); ++id) {
+    const size_t layer = net.getLayer(id);
+    if (layer >= nodesByLayer.size()) {
+      nodesByLayer.resize(layer + 1);
+    }
+    nodesByLayer[layer].push_back(id);
+  }
+  for (std::vector<Net::Id> &layer : nodesByLayer) {
+    std::sort(layer.begin(), layer.end(), [&](Net::Id x, Net::Id y) {
+      return net.getNumber(x) < net.getNumber(y);
+    });
+  }
+
   AdditionalNetFeatures features;
+  features.init(nodesByLayer, getNetEdges(net, nodesByLayer));
+  // Every layer pair is counted
+  features.changeStamps.assign(nodesByLayer.size(), 0);
+  return features.crossCounting();
+}
 
-  features.nodesByLayer = net.getNodesByLayer();
-  features.tempNodesByLayer.resize(features.nodesByLayer.size());
-  std::copy(
-      features.nodesByLayer.begin(),
-      features.nodesByLayer.end(),
-      features.tempNodesByLayer.begin());
+void minimizeIntersections(Net &net, const MinimizationOptions &options) {
+  const std::vector<std::vector<Net::Id>> nodesByLayer = net.getNodesByLayer();
+  const LayerPairEdges netEdges = getNetEdges(net, nodesByLayer);
+
+  const Clock::time_point start = Clock::now();
+  const Clock::time_point deadline = options.timeBudget.count() > 0
+      ? start + options.timeBudget
+      : Clock::time_point::max();
+  std::mutex progressMutex;
+
+  // The first attempt starts from the initial order, the others start from
+  // the random ones. The attempts run concurrently over their own copies of
+  // the orders, a single attempt parallelizes its layers instead
+  const size_t attemptCount = std::max<size_t>(options.attemptCount, 1);
+  std::vector<AdditionalNetFeatures> attempts(attemptCount);
+  WorkerPool::get().run(attemptCount, [&](size_t attempt) {
+    AdditionalNetFeatures &features = attempts[attempt];
+    features.init(nodesByLayer, netEdges);
+    if (attempt != 0) {
+      features.shuffleLayers(options.seed, attempt);
+    }
+    const std::function<void(size_t)> onIteration = [&](size_t iteration) {
+      if (!options.progress) {
+        return;
+      }
+      MinimizationProgress progress;
+      progress.attempt = attempt;
+      progress.iteration = iteration;
+      progress.intersections = features.sweepIntersections;
+      progress.bestIntersections = features.intersections;
+      progress.elapsed =
+          std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+      std::lock_guard<std::mutex> lock(progressMutex);
+      options.progress(progress);
+    };
+    // The heuristic is a template parameter, so the sweeps are compiled for
+    // every heuristic and chosen once here
+    switch (options.heuristic) {
+    case OrderingHeuristic::Barycenter:
+      features.layerSweepAlgorithm<OrderingHeuristic::Barycenter>(
+          net, options.maxIterations, deadline, onIteration);
+      break;
+    case OrderingHeuristic::Median:
+      features.layerSweepAlgorithm<OrderingHeuristic::Median>(
+          net, options.maxIterations, deadline, onIteration);
+      break;
+    case OrderingHeuristic::WeightedMedian:
+      features.layerSweepAlgorithm<OrderingHeuristic::WeightedMedian>(
+          net, options.maxIterations, deadline, onIteration);
+      break;
+    }
+  });
 
-  features.netEdges = getNetEdges(net, features.tempNodesByLayer);
+  // The ties go to the earliest attempt, so the result is reproducible
+  AdditionalNetFeatures *best = &attempts[0];
+  for (AdditionalNetFeatures &features : attempts) {
+    if (features.intersections < best->intersections) {
+      best = &features;
+    }
+  }
 
-  features.layerSweepAlgorithm(net);
+  // The refinement also ends with the time budget of the minimization
+  const Clock::time_point now = Clock::now();
+  if (options.refinementTime.count() > 0 && now < deadline) {
+    best->refine(net, std::min(now + options.refinementTime, deadline));
+  }
 
-  features.setEdgesToOptimalCondition(net);
+  best->setEdgesToOptimalCondition(net);
 
-  portOrderOptimization(net, features.nodesByLayer);
+  portOrderOptimization(net, best->nodesByLayer);
 
-  printf("\nintersections: %i\n", features.intersections);
-}
\ No newline at end of file
+  printf("\nintersections: %lld\n", static_cast<long long>(best->intersections));
+}
@@ -7,6 +7,58 @@
 #define LSVIS_MINIMIZATION_HPP
 
 #include "layout.h"
-void minimizeIntersections(Net &net);
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Layer sweep ordering heuristics: a node is placed at the mean position of
+// its neighbours in the fixed layer (Barycenter), at their median position
+// (Median) or at the median weighted towards the side where the neighbours
+// are denser (WeightedMedian)
+enum class OrderingHeuristic {
+  Barycenter,
+  Median,
+  WeightedMedian
+};
+
+// The state of a layer sweep attempt after a sweep
+struct MinimizationProgress {
+  size_t attempt = 0;
+  // The number of the sweeps done by the attempt
+  size_t iteration = 0;
+  // The crossings after the sweep and the fewest crossings found by the
+  // attempt so far
+  int64_t intersections = 0;
+  int64_t bestIntersections = 0;
+  std::chrono::milliseconds elapsed{0};
+};
+
+struct MinimizationOptions {
+  // The number of the independent layer sweep attempts, every attempt but
+  // the first one starts from a random order, the best result is kept
+  size_t attemptCount = 1;
+  // The seed of the random orders, the same seed gives the same layout
+  uint64_t seed = 0;
+  OrderingHeuristic heuristic = OrderingHeuristic::Barycenter;
+  // The limits of the layer sweeps of every attempt, no limit if zero. With
+  // a limit the sweeps go on until it is reached even without improvements,
+  // the best order found so far is kept
+  size_t maxIterations = 0;
+  std::chrono::milliseconds timeBudget{0};
+  // Called after every sweep of every attempt, the calls are serialized
+  std::function<void(const MinimizationProgress &)> progress;
+  // The time budget of the greedy switch and sifting refinement of the best
+  // order found by the layer sweep, no refinement if zero. The refinement
+  // also stops at the end of timeBudget
+  std::chrono::milliseconds refinementTime{0};
+};
+
+void minimizeIntersections(Net &net, const MinimizationOptions &options = {});
+
+// The number of the crossings of the edges between the neighbouring layers
+// in the current order of the nodes
+int64_t countIntersections(const Net &net);
 
 #endif //LSVIS_MINIMIZATION_HPP
@@ -0,0 +1,70 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "names.h"
+
+#include <algorithm>
+
+// FNV-1a hash function
+uint32_t NameIndex::hash(std::string_view name) {
+  uint64_t value = 14695981039346656037ull;
+  for (unsigned char c : name) {
+    value = (value ^ c) * 1099511628211ull;
+  }
+  return static_cast<uint32_t>(value ^ (value >> 32));
+}
+
+uint32_t NameIndex::find(std::string_view name, const NameArena &arena) const {
+  if (slots.empty()) {
+    return Missing;
+  }
+
+  const uint32_t nameHash = hash(name);
+  const size_t mask = slots.size() - 1;
+  for (size_t i = nameHash & mask; slots[i].index != Missing;
+       i = (i + 1) & mask) {
+    if (slots[i].hash == nameHash && arena.get(slots[i].index) == name) {
+      return slots[i].index;
+    }
+  }
+  return Missing;
+}
+
+void NameIndex::insert(std::string_view name, uint32_t index) {
+  // Keeping the load factor below 1/2
+  if (2 * (count + 1) > slots.size()) {
+    grow();
+  }
+
+  const uint32_t nameHash = hash(name);
+  const size_t mask = slots.size() - 1;
+  size_t i = nameHash & mask;
+  while (slots[i].index != Missing) {
+    i = (i + 1) & mask;
+  }
+  slots[i] = {nameHash, index};
+  count++;
+}
+
+void NameIndex::grow() {
+  std::vector<Slot> oldSlots(std::max<size_t>(16, 2 * slots.size()),
+                             Slot{0, Missing});
+  oldSlots.swap(slots);
+
+  const size_t mask = slots.size() - 1;
+  for (const Slot &slot : oldSlots) {
+    if (slot.index == Missing) {
+      continue;
+    }
+    size_t i = slot.hash & mask;
+    while (slots[i].index != Missing) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = slot;
+  }
+}
@@ -0,0 +1,82 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef NAMES_H_
+#define NAMES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Names stored back to back in a single buffer: the i-th name is
+// chars[offsets[i]], ..., chars[offsets[i + 1] - 1]
+class NameArena {
+  std::string chars = {};
+  std::vector<uint32_t> offsets = {0};
+
+public:
+  uint32_t add(std::string_view name) {
+    chars.append(name);
+    offsets.push_back(chars.size());
+    return static_cast<uint32_t>(offsets.size() - 2);
+  }
+
+  std::string_view get(uint32_t index) const {
+    return std::string_view(chars).substr(
+        offsets[index], offsets[index + 1] - offsets[index]);
+  }
+
+  size_t size() const {
+    return offsets.size() - 1;
+  }
+
+  std::string_view getChars() const {
+    return chars;
+  }
+
+  const std::vector<uint32_t> &getOffsets() const {
+    return offsets;
+  }
+
+  // Replacing the names by the given buffers (offsets has size() + 1 entries)
+  void assign(std::string_view chars, const uint32_t *offsets, size_t count) {
+    this->chars.assign(chars);
+    this->offsets.assign(offsets, offsets + count + 1);
+  }
+};
+
+// An open addressing hash table mapping the names of an arena to their
+// indices. The slots keep only the hashes and the indices, the names are
+// compared against the arena.
+class NameIndex {
+  struct Slot {
+    uint32_t hash;
+    uint32_t index;
+  };
+
+  std::vector<Slot> slots = {};
+  size_t count = 0;
+
+public:
+  static constexpr uint32_t Missing = UINT32_MAX;
+
+  static uint32_t hash(std::string_view name);
+
+  // The index of the name in the arena or Missing
+  uint32_t find(std::string_view name, const NameArena &arena) const;
+
+  // Adding a name which is not in the table yet
+  void insert(std::string_view name, uint32_t index);
+
+private:
+  void grow();
+};
+
+#endif // NAMES_H_
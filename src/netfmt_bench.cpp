@@ -9,85 +9,596 @@
 #include "netfmt_bench.h"
 
 #include "layout.h"
-#include <lorina/bench.hpp>
+#include "mapped_file.h"
+#include "parallel.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
 #include <istream>
+#include <numeric>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #define UNUSED(x) do { (void) (x); } while(0)
 
 namespace {
 
-class BenchNetReader: public lorina::bench_reader {
-  mutable std::unordered_map<std::string, Net::Id> nodeMap;
-  Net &net;
+// A part of the net read from a part of the text. The nodes are numbered
+// in the order of their first reference within the part, the edges are kept
+// in the order they are read.
+struct BenchChunk {
+  using Id = uint32_t;
+
+  NameArena names = {};
+  std::vector<std::pair<Id, Id>> edges = {};
+  std::vector<size_t> drivenLines = {};
+  std::vector<Id> dffs = {};
+
+  Id addNode(std::string_view name) {
+    return names.add(name);
+  }
+
+  const NameArena &getNames() const {
+    return names;
+  }
+
+  void linkNodes(Id src, Id dst) {
+    edges.emplace_back(src, dst);
+  }
+
+  void markDff(Id id) {
+    dffs.push_back(id);
+  }
+};
+
+// Creating the nodes on the first reference and linking them as soon as
+// a statement is read. A name is driven once it is declared as an input or
+// assigned by a statement, the line of the statement is kept (0 if the name
+// is not driven). A name may only be driven once, the undriven names are
+// only checked at the end. The builder is either the net itself or a chunk
+// to be merged into it.
+template <typename Builder>
+class BenchNetReader {
+  using Id = typename Builder::Id;
+
+  // The names are interned into the builder, so the text may be discarded
+  // as soon as it is read
+  NameIndex nodeMap;
+  std::vector<size_t> drivenLines;
+  Builder &builder;
 
 public:
-  explicit BenchNetReader(Net &net)
-      : net(net) {
+  explicit BenchNetReader(Builder &builder)
+      : builder(builder) {
     return;
   }
 
-  virtual void on_input(const std::string &name) const override {
-    UNUSED(getNode(name));
+  // The methods driving a signal return false if it is already driven
+  bool onInput(std::string_view name, size_t line) {
+    Id id;
+    return getOutputNode(name, line, id);
   }
 
-  virtual void on_output(const std::string &name) const override {
+  void onOutput(std::string_view name) {
     UNUSED(getNode(name));
   }
 
-  virtual void on_dff_input(const std::string &input) const override {
-    UNUSED(getNode(input));
-  }
-
-  virtual void on_dff(
-      const std::string &input, const std::string &output) const override {
-    linkNodes(getNode(input), getNode(output));
+  bool onDff(std::string_view input, std::string_view output, size_t line) {
+    Id dst;
+    if (!getOutputNode(output, line, dst)) {
+      return false;
+    }
+    builder.markDff(dst);
+    linkNodes(getNode(input), dst);
+    return true;
   }
 
-  virtual void on_gate(
-      const std::vector<std::string> &inputs,
-      const std::string &output,
-      const std::string &type) const override {
+  bool onGate(
+      const std::vector<std::string_view> &inputs,
+      std::string_view output,
+      std::string_view type,
+      size_t line) {
     UNUSED(type);
 
-    TreeNode *dst = getNode(output);
-    for (const std::string &input: inputs) {
+    Id dst;
+    if (!getOutputNode(output, line, dst)) {
+      return false;
+    }
+    for (std::string_view input: inputs) {
       linkNodes(getNode(input), dst);
     }
+    return true;
+  }
+
+  bool onAssign(std::string_view input, std::string_view output, size_t line) {
+    Id dst;
+    if (!getOutputNode(output, line, dst)) {
+      return false;
+    }
+    linkNodes(getNode(input), dst);
+    return true;
+  }
+
+  std::vector<size_t> &getDrivenLines() {
+    return drivenLines;
+  }
+
+private:
+  void linkNodes(Id src, Id dst) {
+    builder.linkNodes(src, dst);
+  }
+
+  bool getOutputNode(std::string_view name, size_t line, Id &id) {
+    id = getNode(name);
+    if (drivenLines[id] != 0) {
+      return false;
+    }
+    drivenLines[id] = line;
+    return true;
+  }
+
+  Id getNode(std::string_view name) {
+    Id id = nodeMap.find(name, builder.getNames());
+    if (id != NameIndex::Missing) {
+      return id;
+    }
+
+    id = builder.addNode(name);
+    nodeMap.insert(name, id);
+    drivenLines.push_back(0);
+    return id;
+  }
+};
+
+bool checkUnresolved(
+    const char *source, const Net &net, const std::vector<size_t> &drivenLines) {
+  bool result = true;
+  for (Net::Id id = 0; id < drivenLines.size(); id++) {
+    // The constants are known without a declaration
+    const std::string_view name = net.getName(id);
+    if (drivenLines[id] == 0 && name != "vdd" && name != "gnd") {
+      std::cerr << source << ": unresolved signal '" << net.getName(id)
+                << "'" << std::endl;
+      result = false;
+    }
+  }
+  return result;
+}
+
+enum class BenchToken {
+  Name,
+  // A character that cannot start a token, a backslash not ending the line
+  Invalid,
+  Open,
+  Close,
+  Comma,
+  Assign,
+  EndOfLine,
+  EndOfFile
+};
+
+// Splitting the BENCH text into tokens without copying it: names are
+// returned as views into the text. Comments are skipped, the lines ending
+// with a backslash are continued.
+class BenchScanner {
+  const char *current;
+  const char *end;
+  size_t line;
+
+public:
+  BenchScanner(std::string_view text, size_t line)
+      : current(text.data()), end(text.data() + text.size()), line(line) {}
+
+  size_t getLine() const {
+    return line;
   }
 
-  virtual void on_assign(
-      const std::string &input, const std::string &output) const override {
-    linkNodes(getNode(input), getNode(output));
+  BenchToken next(std::string_view &name) {
+    skipSpaces();
+    if (current == end) {
+      return BenchToken::EndOfFile;
+    }
+
+    switch (*current) {
+    case '\n':
+      current++;
+      line++;
+      return BenchToken::EndOfLine;
+    case '#':
+      while (current != end && *current != '\n') {
+        current++;
+      }
+      return next(name);
+    case '(':
+      current++;
+      return BenchToken::Open;
+    case ')':
+      current++;
+      return BenchToken::Close;
+    case ',':
+      current++;
+      return BenchToken::Comma;
+    case '=':
+      current++;
+      return BenchToken::Assign;
+    }
+
+    const char *first = current;
+    while (current != end && isNameChar(*current)) {
+      current++;
+    }
+    if (current == first) {
+      // A stray backslash
+      current++;
+      name = std::string_view(first, 1);
+      return BenchToken::Invalid;
+    }
+    name = std::string_view(first, current - first);
+    return BenchToken::Name;
   }
 
 private:
-  void linkNodes(TreeNode *src, TreeNode *dst) const {
-    src->succ.push_back(dst->id);
-    dst->pred.push_back(src->id);
+  static bool isNameChar(char c) {
+    switch (c) {
+    case ' ': case '\t': case '\r': case '\n':
+    case '(': case ')': case ',': case '=': case '#': case '\\':
+      return false;
+    }
+    return true;
   }
 
-  TreeNode *getNode(const std::string &name) const {
-    Net::Id id;
+  void skipSpaces() {
+    while (current != end) {
+      if (*current == ' ' || *current == '\t' || *current == '\r') {
+        current++;
+      } else if (*current == '\\' && continuesLine()) {
+        current = std::find(current, end, '\n') + 1;
+        line++;
+      } else {
+        break;
+      }
+    }
+  }
 
-    auto it = nodeMap.find(name);
-    if (it != nodeMap.end()) {
-      id = it->second;
-    } else {
-      id = net.addNode();
-      nodeMap.emplace(name, id);
+  bool continuesLine() const {
+    for (const char *c = current + 1; c != end; c++) {
+      if (*c == '\n') {
+        return true;
+      }
+      if (*c != ' ' && *c != '\t' && *c != '\r') {
+        return false;
+      }
     }
-    return net.getNode(id);
+    return false;
+  }
+};
+
+bool isEndOfStatement(BenchToken token) {
+  return token == BenchToken::EndOfLine || token == BenchToken::EndOfFile;
+}
+
+// Parsing the statements of the BENCH format:
+//   INPUT(<name>), OUTPUT(<name>),
+//   <name> = <type>(<name>, ...), <name> = LUT <hex>(<name>, ...),
+//   <name> = <name>
+// The text may be passed in parts split at the statement boundaries.
+template <typename Builder>
+class BenchParser {
+  BenchNetReader<Builder> reader;
+  std::vector<std::string_view> inputs;
+  const char *source;
+  std::ostream &errors;
+  size_t line;
+
+public:
+  BenchParser(Builder &builder, const char *source,
+              std::ostream &errors = std::cerr, size_t firstLine = 1)
+      : reader(builder), source(source), errors(errors), line(firstLine) {}
+
+  bool parse(std::string_view text);
+
+  std::vector<size_t> &getDrivenLines() {
+    return reader.getDrivenLines();
+  }
+
+  // The line of the error the parsing stopped at
+  size_t getErrorLine() const {
+    return errorLine;
+  }
+
+private:
+  size_t errorLine = 0;
+
+  bool reportError(size_t line, const std::string &message) {
+    errorLine = line;
+    errors << source << ":" << line << ": " << message << std::endl;
+    return false;
+  }
+
+  bool reportRedefinition(size_t line, std::string_view name) {
+    return reportError(line, "signal '" + std::string(name) + "' is already driven");
   }
 };
 
+template <typename Builder>
+bool BenchParser<Builder>::parse(std::string_view text) {
+  BenchScanner scanner(text, line);
+
+  while (true) {
+    const size_t line = scanner.getLine();
+    std::string_view output;
+    BenchToken token = scanner.next(output);
+    if (token == BenchToken::EndOfFile) {
+      this->line = line;
+      return true;
+    }
+    if (token == BenchToken::EndOfLine) {
+      continue;
+    }
+    if (token == BenchToken::Invalid) {
+      return reportError(line, "unexpected '" + std::string(output) + "'");
+    }
+    if (token != BenchToken::Name) {
+      return reportError(line, "expected a signal name");
+    }
+
+    std::string_view name;
+    token = scanner.next(name);
+    if (token == BenchToken::Open) {
+      if (scanner.next(name) != BenchToken::Name ||
+          scanner.next(name) != BenchToken::Close) {
+        return reportError(line, "expected '(<name>)'");
+      }
+      std::string_view dummy;
+      if (!isEndOfStatement(scanner.next(dummy))) {
+        return reportError(line, "unexpected token after ')'");
+      }
+
+      if (output == "INPUT") {
+        if (!reader.onInput(name, line)) {
+          return reportRedefinition(line, name);
+        }
+      } else if (output == "OUTPUT") {
+        reader.onOutput(name);
+      } else {
+        return reportError(line, "expected INPUT or OUTPUT");
+      }
+      continue;
+    }
+    if (token != BenchToken::Assign) {
+      return reportError(line, "expected '=' or '('");
+    }
+
+    std::string_view type;
+    if (scanner.next(type) != BenchToken::Name) {
+      return reportError(line, "expected a gate type or a name");
+    }
+    token = scanner.next(name);
+    if (isEndOfStatement(token)) {
+      if (!reader.onAssign(type, output, line)) {
+        return reportRedefinition(line, output);
+      }
+      continue;
+    }
+    if (token == BenchToken::Name && type == "LUT") {
+      type = std::string_view(type.data(), name.data() + name.size() - type.data());
+      token = scanner.next(name);
+    }
+    if (token != BenchToken::Open) {
+      return reportError(line, "expected '('");
+    }
+
+    inputs.clear();
+    do {
+      if (scanner.next(name) != BenchToken::Name) {
+        return reportError(line, "expected a gate input name");
+      }
+      inputs.push_back(name);
+      token = scanner.next(name);
+    } while (token == BenchToken::Comma);
+    if (token != BenchToken::Close) {
+      return reportError(line, "expected ',' or ')'");
+    }
+    if (!isEndOfStatement(scanner.next(name))) {
+      return reportError(line, "unexpected token after ')'");
+    }
+
+    if (type == "DFF") {
+      if (inputs.size() != 1) {
+        return reportError(line, "DFF must have a single input");
+      }
+      if (!reader.onDff(inputs.front(), output, line)) {
+        return reportRedefinition(line, output);
+      }
+    } else if (!reader.onGate(inputs, output, type, line)) {
+      return reportRedefinition(line, output);
+    }
+  }
+}
+
+// The end of the last complete statement in the text
+size_t findStatementsEnd(std::string_view text) {
+  size_t end = text.size();
+  while (end > 0) {
+    end = text.rfind('\n', end - 1);
+    if (end == std::string_view::npos) {
+      return 0;
+    }
+    // A backslash before the line end continues the statement
+    size_t last = end > 0 ? text.find_last_not_of(" \t\r", end - 1)
+                          : std::string_view::npos;
+    if (last == std::string_view::npos || text[last] != '\\') {
+      return end + 1;
+    }
+  }
+  return 0;
+}
+
+// The beginning of the first statement starting at or after the position
+size_t findStatementStart(std::string_view text, size_t pos) {
+  while (pos < text.size()) {
+    const size_t end = text.find('\n', pos);
+    if (end == std::string_view::npos) {
+      return text.size();
+    }
+    const size_t last = end > 0 ? text.find_last_not_of(" \t\r", end - 1)
+                                : std::string_view::npos;
+    if (last == std::string_view::npos || text[last] != '\\') {
+      return end + 1;
+    }
+    pos = end + 1;
+  }
+  return text.size();
+}
+
+// Parsing the chunks of the text on the worker threads and merging them into
+// the net in the text order. Every chunk is interned into its own table, the
+// merge assigns the net ids in the order of the first reference in the whole
+// text, so the ids do not depend on the number of chunks.
+bool readChunks(std::string_view text, const char *source, Net &net,
+                size_t chunkCount) {
+  std::vector<size_t> bounds = {0};
+  for (size_t i = 1; i < chunkCount; i++) {
+    const size_t bound = findStatementStart(
+        text, std::max(bounds.back(), i * text.size() / chunkCount));
+    if (bound != bounds.back() && bound != text.size()) {
+      bounds.push_back(bound);
+    }
+  }
+  bounds.push_back(text.size());
+  chunkCount = bounds.size() - 1;
+
+  std::vector<BenchChunk> chunks(chunkCount);
+  std::vector<size_t> lineCounts(chunkCount);
+  std::vector<std::ostringstream> errors(chunkCount);
+  std::vector<uint8_t> parsed(chunkCount);
+  std::vector<size_t> errorLines(chunkCount);
+  WorkerPool &pool = WorkerPool::get();
+
+  pool.run(chunkCount, [&](size_t i) {
+    const std::string_view chunk = text.substr(bounds[i], bounds[i + 1] - bounds[i]);
+    lineCounts[i] = std::count(chunk.begin(), chunk.end(), '\n');
+  });
+
+  pool.run(chunkCount, [&](size_t i) {
+    const std::string_view chunk = text.substr(bounds[i], bounds[i + 1] - bounds[i]);
+    const size_t firstLine = 1 + std::accumulate(
+        lineCounts.begin(), lineCounts.begin() + i, size_t{0});
+    BenchParser<BenchChunk> parser(chunks[i], source, errors[i], firstLine);
+    parsed[i] = parser.parse(chunk);
+    errorLines[i] = parser.getErrorLine();
+    chunks[i].drivenLines = std::move(parser.getDrivenLines());
+  });
+
+  // The chunks are merged in the text order and only the first error is
+  // reported as the serial parser would do. A signal driven again in a later
+  // chunk is only found by the merge
+  NameIndex nodeMap;
+  std::vector<size_t> drivenLines;
+  std::vector<Net::Id> ids;
+  for (size_t i = 0; i < chunkCount; i++) {
+    BenchChunk &chunk = chunks[i];
+    size_t redefinedLine = 0;
+    std::string_view redefinedName;
+    ids.resize(chunk.names.size());
+    for (BenchChunk::Id local = 0; local < ids.size(); local++) {
+      const std::string_view name = chunk.names.get(local);
+      Net::Id id = nodeMap.find(name, net.getNames());
+      if (id == NameIndex::Missing) {
+        id = net.addNode(name);
+        nodeMap.insert(name, id);
+        drivenLines.push_back(0);
+      }
+      ids[local] = id;
+      const size_t line = chunk.drivenLines[local];
+      if (line == 0) {
+        continue;
+      }
+      if (drivenLines[id] == 0) {
+        drivenLines[id] = line;
+      } else if (redefinedLine == 0 || line < redefinedLine) {
+        redefinedLine = line;
+        redefinedName = name;
+      }
+    }
+    if (redefinedLine != 0 && (parsed[i] || redefinedLine < errorLines[i])) {
+      std::cerr << source << ":" << redefinedLine << ": signal '"
+                << redefinedName << "' is already driven" << std::endl;
+      return false;
+    }
+    if (!parsed[i]) {
+      std::cerr << errors[i].str();
+      return false;
+    }
+    for (const auto &[src, dst] : chunk.edges) {
+      net.linkNodes(ids[src], ids[dst]);
+    }
+    for (BenchChunk::Id dff : chunk.dffs) {
+      net.markDff(ids[dff]);
+    }
+    chunk = BenchChunk();
+  }
+  return checkUnresolved(source, net, drivenLines);
+}
+
 } // end namespace
 
+// The stream is read block by block and every complete statement is linked
+// into the net at once, so the memory depends on the net size only
 bool
 readNetFromBench(std::istream &is, Net &net) {
-  BenchNetReader reader(net);
-  auto result = lorina::read_bench(is, reader);
-  return result == lorina::return_code::success;
+  constexpr size_t BlockSize = 1 << 16;
+
+  BenchParser<Net> parser(net, "<stream>");
+  std::string buffer;
+  bool result = true;
+  while (result) {
+    const size_t tail = buffer.size();
+    buffer.resize(tail + BlockSize);
+    is.read(buffer.data() + tail, BlockSize);
+    buffer.resize(tail + is.gcount());
+
+    const bool isLast = !is;
+    const size_t end = isLast ? buffer.size() : findStatementsEnd(buffer);
+    result = parser.parse(std::string_view(buffer).substr(0, end));
+    buffer.erase(0, end);
+    if (isLast) {
+      break;
+    }
+  }
+  result = result && checkUnresolved("<stream>", net, parser.getDrivenLines());
+
+  net.buildAdjacency();
+  return result;
+}
+
+// The mapped file is split into a chunk per thread, the files smaller than
+// a few chunks are parsed on the calling thread
+bool
+readNetFromBenchFile(const char *filename, Net &net) {
+  constexpr size_t MinChunkSize = 1 << 22;
+
+  MappedFile file;
+  if (!file.open(filename)) {
+    std::cerr << filename << ": cannot open the file" << std::endl;
+    return false;
+  }
+  const std::string_view text = file.getData();
+  const size_t chunkCount = std::min<size_t>(
+      WorkerPool::get().getThreadCount(), text.size() / MinChunkSize);
+
+  bool result;
+  if (chunkCount > 1) {
+    result = readChunks(text, filename, net, chunkCount);
+  } else {
+    BenchParser<Net> parser(net, filename);
+    result = parser.parse(text) &&
+             checkUnresolved(filename, net, parser.getDrivenLines());
+  }
+  net.buildAdjacency();
+  return result;
 }
@@ -14,5 +14,6 @@
 struct Net;
 
 bool readNetFromBench(std::istream &is, Net &net);
+bool readNetFromBenchFile(const char *filename, Net &net);
 
 #endif
@@ -0,0 +1,113 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "parallel.h"
+
+#include <atomic>
+
+namespace {
+unsigned sharedThreadCount = 0;
+thread_local bool insideTask = false;
+} // end namespace
+
+struct WorkerPool::Job {
+  const std::function<void(size_t)> &task;
+  const size_t taskCount;
+  std::atomic<size_t> nextTask;
+};
+
+WorkerPool::WorkerPool(unsigned threadCount) {
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned i = 1; i < threadCount; i++) {
+    workers.emplace_back(&WorkerPool::workerLoop, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wakeUp.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+WorkerPool &WorkerPool::get() {
+  static WorkerPool pool(sharedThreadCount);
+  return pool;
+}
+
+void WorkerPool::setThreadCount(unsigned threadCount) {
+  sharedThreadCount = threadCount;
+}
+
+void WorkerPool::execute(Job &job) {
+  const bool wasInsideTask = insideTask;
+  insideTask = true;
+  for (size_t i = job.nextTask++; i < job.taskCount; i = job.nextTask++) {
+    job.task(i);
+  }
+  insideTask = wasInsideTask;
+}
+
+void WorkerPool::run(size_t taskCount,
+                     const std::function<void(size_t)> &task) {
+  if (insideTask || workers.empty() || taskCount <= 1) {
+    for (size_t i = 0; i < taskCount; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> runLock(runMutex);
+  Job job{task, taskCount, {0}};
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    currentJob = &job;
+    // The jobs live on the stack and often get the same address, so the
+    // workers tell them apart by the generation
+    jobGeneration++;
+  }
+  wakeUp.notify_all();
+
+  execute(job);
+
+  // The job lives on this stack, so no worker may keep it afterwards
+  std::unique_lock<std::mutex> lock(mutex);
+  currentJob = nullptr;
+  finished.wait(lock, [this] { return activeWorkers == 0; });
+}
+
+void WorkerPool::workerLoop() {
+  uint64_t seenGeneration = 0;
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex);
+    wakeUp.wait(lock, [&] {
+      return stopping || (currentJob && jobGeneration != seenGeneration);
+    });
+    if (stopping) {
+      return;
+    }
+
+    Job *job = currentJob;
+    seenGeneration = jobGeneration;
+    activeWorkers++;
+    lock.unlock();
+
+    execute(*job);
+
+    lock.lock();
+    if (--activeWorkers == 0) {
+      finished.notify_all();
+    }
+  }
+}
@@ -0,0 +1,113 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads executing the tasks of parallel loops.
+// The calling thread takes part in the loop, so a pool of N threads starts
+// N - 1 workers. Loops started from inside a task run serially.
+class WorkerPool {
+  struct Job;
+
+  std::vector<std::thread> workers = {};
+  std::mutex mutex = {};
+  std::mutex runMutex = {};
+  std::condition_variable wakeUp = {};
+  std::condition_variable finished = {};
+  Job *currentJob = nullptr;
+  // Incremented by every job started, so that every worker joins it once
+  uint64_t jobGeneration = 0;
+  size_t activeWorkers = 0;
+  bool stopping = false;
+
+  explicit WorkerPool(unsigned threadCount);
+
+public:
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+  ~WorkerPool();
+
+  // The pool shared by the whole program
+  static WorkerPool &get();
+
+  // Setting the number of threads of the shared pool (0 for the number of
+  // hardware threads). It takes effect only before the first get() call
+  static void setThreadCount(unsigned threadCount);
+
+  unsigned getThreadCount() const {
+    return workers.size() + 1;
+  }
+
+  // Calling task(i) for every i in [0, taskCount) and waiting for all calls
+  void run(size_t taskCount, const std::function<void(size_t)> &task);
+
+private:
+  static void execute(Job &job);
+  void workerLoop();
+};
+
+// Splitting [0, count) into ranges of at least minRange elements and calling
+// body(begin, end) for the ranges in parallel
+template <typename Body>
+void parallelFor(size_t count, size_t minRange, Body &&body) {
+  WorkerPool &pool = WorkerPool::get();
+  const size_t rangeCount = std::min<size_t>(
+      4 * pool.getThreadCount(), (count + minRange - 1) / std::max<size_t>(minRange, 1));
+  if (rangeCount <= 1) {
+    body(size_t{0}, count);
+    return;
+  }
+  pool.run(rangeCount, [&](size_t i) {
+    body(i * count / rangeCount, (i + 1) * count / rangeCount);
+  });
+}
+
+// Sorting [first, last) by sorting at least minRange elements long ranges in
+// parallel and merging them pairwise. The comparator must be a strict total
+// order, so that the result does not depend on the number of threads
+template <typename Iterator, typename Compare>
+void parallelSort(Iterator first, Iterator last, size_t minRange, Compare comp) {
+  WorkerPool &pool = WorkerPool::get();
+  const size_t count = last - first;
+  const size_t rangeCount = std::min<size_t>(
+      pool.getThreadCount(), count / std::max<size_t>(minRange, 1));
+  if (rangeCount <= 1) {
+    std::sort(first, last, comp);
+    return;
+  }
+
+  std::vector<size_t> bounds(rangeCount + 1);
+  for (size_t i = 0; i <= rangeCount; i++) {
+    bounds[i] = i * count / rangeCount;
+  }
+  pool.run(rangeCount, [&](size_t i) {
+    std::sort(first + bounds[i], first + bounds[i + 1], comp);
+  });
+  for (size_t width = 1; width < rangeCount; width *= 2) {
+    pool.run((rangeCount + 2 * width - 1) / (2 * width), [&](size_t i) {
+      const size_t begin = 2 * i * width;
+      const size_t middle = std::min(begin + width, rangeCount);
+      const size_t end = std::min(begin + 2 * width, rangeCount);
+      std::inplace_merge(
+          first + bounds[begin], first + bounds[middle], first + bounds[end],
+          comp);
+    });
+  }
+}
+
+#endif // PARALLEL_H_
@@ -0,0 +1,364 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "snapshot.h"
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <string_view>
+#include <type_traits>
+
+namespace {
+
+constexpr char SnapshotMagic[8] = {'L', 'S', 'V', 'S', 'N', 'A', 'P', '\0'};
+// Snapshots are written in the native byte order and rejected elsewhere
+constexpr uint32_t ByteOrderMark = 0x01020304;
+constexpr uint64_t SectionAlignment = 8;
+
+enum Section : uint32_t {
+  SuccOffsets,
+  SuccIds,
+  PredOffsets,
+  PredIds,
+  Layers,
+  Numbers,
+  Dummies,
+  Dffs,
+  NameOffsets,
+  NameChars,
+  Elements,
+  ConnectionOffsets,
+  Connections,
+  VertexOffsets,
+  Vertices,
+  SectionCount
+};
+
+struct SectionEntry {
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t nodeCount;
+  uint64_t nameCount;
+  uint64_t elementCount;
+  uint64_t connectionCount;
+  uint64_t vertexCount;
+  SectionEntry sections[SectionCount];
+};
+
+struct ElementRecord {
+  uint32_t id;
+  float x, y, w, h;
+};
+
+struct ConnectionRecord {
+  uint32_t id;
+  uint32_t startElementId;
+  uint32_t endElementId;
+};
+
+struct VertexRecord {
+  float x, y;
+};
+
+static_assert(sizeof(int) == sizeof(int32_t), "layers are stored as int32");
+static_assert(std::is_trivially_copyable_v<SnapshotHeader>);
+
+// Writing the sections one after another and the header with their
+// positions at the end
+class SnapshotWriter {
+  std::ofstream os;
+  SnapshotHeader header = {};
+  uint64_t offset = sizeof(SnapshotHeader);
+
+public:
+  explicit SnapshotWriter(const char *filename)
+      : os(filename, std::ios::binary | std::ios::trunc) {
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+
+  SnapshotHeader &getHeader() {
+    return header;
+  }
+
+  template <typename T>
+  void write(Section section, const T *data, size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const uint64_t size = count * sizeof(T);
+    header.sections[section] = {offset, size};
+    os.write(reinterpret_cast<const char*>(data), size);
+
+    const uint64_t padding = (SectionAlignment - size % SectionAlignment) %
+                             SectionAlignment;
+    const char zeros[SectionAlignment] = {};
+    os.write(zeros, padding);
+    offset += size + padding;
+  }
+
+  template <typename T>
+  void write(Section section, const std::vector<T> &data) {
+    write(section, data.data(), data.size());
+  }
+
+  bool finish() {
+    std::memcpy(header.magic, SnapshotMagic, sizeof(SnapshotMagic));
+    header.version = SnapshotVersion;
+    header.byteOrder = ByteOrderMark;
+    os.seekp(0);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.close();
+    return !os.fail();
+  }
+};
+
+// Copying the sections out of the mapped file
+class SnapshotReader {
+  std::string_view data;
+  SnapshotHeader header = {};
+
+public:
+  explicit SnapshotReader(std::string_view data)
+      : data(data) {}
+
+  bool readHeader() {
+    if (data.size() < sizeof(header)) {
+      return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 ||
+        header.version != SnapshotVersion ||
+        header.byteOrder != ByteOrderMark) {
+      return false;
+    }
+    return true;
+  }
+
+  bool hasSections() const {
+    for (const SectionEntry &entry : header.sections) {
+      if (entry.offset > data.size() || entry.size > data.size() - entry.offset) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Every counted record takes at least a byte of the file, so a larger
+  // count is corrupted and would overflow when the offsets get their extra
+  // entry
+  bool hasCounts() const {
+    for (uint64_t count : {header.nodeCount, header.nameCount, header.elementCount,
+                           header.connectionCount, header.vertexCount}) {
+      if (count >= data.size()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const SnapshotHeader &getHeader() const {
+    return header;
+  }
+
+  template <typename T>
+  bool read(Section section, uint64_t count, std::vector<T> &values) const {
+    const SectionEntry &entry = header.sections[section];
+    if (entry.size % sizeof(T) != 0 || entry.size / sizeof(T) != count) {
+      return false;
+    }
+    values.resize(count);
+    std::memcpy(values.data(), data.data() + entry.offset, entry.size);
+    return true;
+  }
+
+  std::string_view readChars(Section section) const {
+    const SectionEntry &entry = header.sections[section];
+    return data.substr(entry.offset, entry.size);
+  }
+};
+
+bool isValidAdjacency(const Adjacency &adjacency, size_t nodeCount) {
+  return !adjacency.offsets.empty() && adjacency.offsets.front() == 0 &&
+         adjacency.offsets.back() == adjacency.ids.size() &&
+         std::is_sorted(adjacency.offsets.begin(), adjacency.offsets.end()) &&
+         std::all_of(adjacency.ids.begin(), adjacency.ids.end(),
+                     [&](NodeId id) { return id < nodeCount; });
+}
+
+bool isValidOffsets(const std::vector<uint32_t> &offsets, uint64_t size) {
+  return !offsets.empty() && offsets.front() == 0 && offsets.back() == size &&
+         std::is_sorted(offsets.begin(), offsets.end());
+}
+
+} // end namespace
+
+bool isSnapshotFile(const char *filename) {
+  std::ifstream is(filename, std::ios::binary);
+  char magic[sizeof(SnapshotMagic)] = {};
+  is.read(magic, sizeof(magic));
+  return is && std::memcmp(magic, SnapshotMagic, sizeof(magic)) == 0;
+}
+
+bool saveSnapshot(
+    const char *filename,
+    const Net &net,
+    const std::vector<NormalizedElement> &normalizedElements) {
+  std::vector<ElementRecord> elements;
+  std::vector<uint32_t> connectionOffsets = {0};
+  std::vector<ConnectionRecord> connections;
+  std::vector<uint32_t> vertexOffsets = {0};
+  std::vector<VertexRecord> vertices;
+
+  elements.reserve(normalizedElements.size());
+  for (const NormalizedElement &element : normalizedElements) {
+    elements.push_back({element.id, element.nPoint.nX, element.nPoint.nY,
+                        element.nW, element.nH});
+    for (const NormalizedConnection &connection : element.connections) {
+      connections.push_back({connection.id, connection.startElementId,
+                             connection.endElementId});
+      for (const NormalizedPoint &point : connection.nVertices) {
+        vertices.push_back({point.nX, point.nY});
+      }
+      vertexOffsets.push_back(vertices.size());
+    }
+    connectionOffsets.push_back(connections.size());
+  }
+
+  SnapshotWriter writer(filename);
+  SnapshotHeader &header = writer.getHeader();
+  header.nodeCount = net.nodes.size();
+  header.nameCount = net.names.size();
+  header.elementCount = elements.size();
+  header.connectionCount = connections.size();
+  header.vertexCount = vertices.size();
+
+  writer.write(SuccOffsets, net.succ.offsets);
+  writer.write(SuccIds, net.succ.ids);
+  writer.write(PredOffsets, net.pred.offsets);
+  writer.write(PredIds, net.pred.ids);
+  writer.write(Layers, net.nodes.layers);
+  writer.write(Numbers, net.nodes.numbers);
+  writer.write(Dummies, net.nodes.dummies);
+  writer.write(Dffs, net.nodes.dffs);
+  writer.write(NameOffsets, net.names.getOffsets());
+  const std::string_view chars = net.names.getChars();
+  writer.write(NameChars, chars.data(), chars.size());
+  writer.write(Elements, elements);
+  writer.write(ConnectionOffsets, connectionOffsets);
+  writer.write(Connections, connections);
+  writer.write(VertexOffsets, vertexOffsets);
+  writer.write(Vertices, vertices);
+
+  if (!writer.finish()) {
+    std::cerr << filename << ": cannot write the snapshot" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool loadSnapshot(
+    const char *filename,
+    Net &net,
+    std::vector<NormalizedElement> &normalizedElements) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    std::cerr << filename << ": cannot open the file" << std::endl;
+    return false;
+  }
+  SnapshotReader reader(file.getData());
+  if (!reader.readHeader()) {
+    std::cerr << filename << ": not a snapshot of version "
+              << SnapshotVersion << std::endl;
+    return false;
+  }
+  if (!reader.hasSections()) {
+    std::cerr << filename << ": the snapshot is truncated" << std::endl;
+    return false;
+  }
+
+  const SnapshotHeader &header = reader.getHeader();
+  const uint64_t nodeCount = header.nodeCount;
+  std::vector<uint32_t> nameOffsets;
+  std::vector<ElementRecord> elements;
+  std::vector<uint32_t> connectionOffsets;
+  std::vector<ConnectionRecord> connections;
+  std::vector<uint32_t> vertexOffsets;
+  std::vector<VertexRecord> vertices;
+
+  net = Net();
+  bool result =
+      reader.hasCounts() &&
+      reader.read(SuccOffsets, nodeCount + 1, net.succ.offsets) &&
+      reader.read(SuccIds, net.succ.offsets.back(), net.succ.ids) &&
+      reader.read(PredOffsets, nodeCount + 1, net.pred.offsets) &&
+      reader.read(PredIds, net.pred.offsets.back(), net.pred.ids) &&
+      reader.read(Layers, nodeCount, net.nodes.layers) &&
+      reader.read(Numbers, nodeCount, net.nodes.numbers) &&
+      reader.read(Dummies, nodeCount, net.nodes.dummies) &&
+      reader.read(Dffs, nodeCount, net.nodes.dffs) &&
+      reader.read(NameOffsets, header.nameCount + 1, nameOffsets) &&
+      reader.read(Elements, header.elementCount, elements) &&
+      reader.read(ConnectionOffsets, header.elementCount + 1, connectionOffsets) &&
+      reader.read(Connections, header.connectionCount, connections) &&
+      reader.read(VertexOffsets, header.connectionCount + 1, vertexOffsets) &&
+      reader.read(Vertices, header.vertexCount, vertices);
+
+  const std::string_view chars = reader.readChars(NameChars);
+  result = result && header.nameCount <= nodeCount &&
+           isValidAdjacency(net.succ, nodeCount) &&
+           isValidAdjacency(net.pred, nodeCount) &&
+           isValidOffsets(nameOffsets, chars.size()) &&
+           isValidOffsets(connectionOffsets, connections.size()) &&
+           isValidOffsets(vertexOffsets, vertices.size());
+  if (!result) {
+    std::cerr << filename << ": the snapshot is corrupted" << std::endl;
+    net = Net();
+    return false;
+  }
+
+  net.nodes.barycentricValues.assign(nodeCount, 0);
+  net.names.assign(chars, nameOffsets.data(), header.nameCount);
+  net.adjacencyBuilt = true;
+
+  normalizedElements.clear();
+  normalizedElements.resize(elements.size());
+  for (size_t i = 0; i < elements.size(); i++) {
+    NormalizedElement &element = normalizedElements[i];
+    element.id = elements[i].id;
+    element.nPoint.nX = elements[i].x;
+    element.nPoint.nY = elements[i].y;
+    element.nW = elements[i].w;
+    element.nH = elements[i].h;
+
+    element.connections.resize(connectionOffsets[i + 1] - connectionOffsets[i]);
+    for (size_t j = 0; j < element.connections.size(); j++) {
+      const size_t c = connectionOffsets[i] + j;
+      NormalizedConnection &connection = element.connections[j];
+      connection.id = connections[c].id;
+      connection.startElementId = connections[c].startElementId;
+      connection.endElementId = connections[c].endElementId;
+      for (uint32_t v = vertexOffsets[c]; v < vertexOffsets[c + 1]; v++) {
+        NormalizedPoint point;
+        point.nX = vertices[v].x;
+        point.nY = vertices[v].y;
+        connection.nVertices.push_back(point);
+      }
+    }
+  }
+  return true;
+}
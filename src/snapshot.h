@@ -0,0 +1,38 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "layout.h"
+#include "main.h"
+
+// Versioned binary snapshots of a laid out net. The adjacency, the node
+// attributes, the names and the element geometry are stored as flat arrays
+// and copied out of the mapped file without parsing.
+
+// Incremented whenever the layout of the file changes
+constexpr uint32_t SnapshotVersion = 2;
+
+// Checking whether the file starts with the snapshot signature
+bool isSnapshotFile(const char *filename);
+
+bool saveSnapshot(
+    const char *filename,
+    const Net &net,
+    const std::vector<NormalizedElement> &normalizedElements);
+
+bool loadSnapshot(
+    const char *filename,
+    Net &net,
+    std::vector<NormalizedElement> &normalizedElements);
+
+#endif // SNAPSHOT_H_
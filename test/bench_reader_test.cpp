@@ -0,0 +1,153 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "layout.h"
+#include "netfmt_bench.h"
+#include "parallel.h"
+#include "test_util.h"
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Reading the text both from a stream and from a file, the results and the
+// error messages must agree
+bool readBench(const std::string &text, Net &net, std::string &errors) {
+  net = Net();
+  std::ostringstream streamErrors;
+  std::streambuf *cerrBuffer = std::cerr.rdbuf(streamErrors.rdbuf());
+  std::istringstream in(text);
+  const bool streamResult = readNetFromBench(in, net);
+
+  std::ostringstream fileErrors;
+  std::cerr.rdbuf(fileErrors.rdbuf());
+  const std::string filename = writeTempFile(text);
+  Net fileNet;
+  const bool fileResult = readNetFromBenchFile(filename.c_str(), fileNet);
+  std::cerr.rdbuf(cerrBuffer);
+  std::remove(filename.c_str());
+
+  CHECK(streamResult == fileResult);
+  CHECK(net.getNodeCount() == fileNet.getNodeCount() || !streamResult);
+  errors = streamErrors.str();
+  // The file errors are prefixed by the file name instead of <stream>
+  const std::string fileMessage = fileErrors.str();
+  CHECK(errors.empty() == fileMessage.empty());
+  if (!errors.empty() && !fileMessage.empty()) {
+    CHECK(fileMessage.substr(fileMessage.find(':')) == errors.substr(errors.find(':')));
+  }
+  return streamResult;
+}
+
+bool hasError(const std::string &errors, const std::string &message) {
+  return errors.find(message) != std::string::npos;
+}
+
+void testValidNet() {
+  Net net;
+  std::string errors;
+  CHECK(readBench("# comment\n"
+                  "INPUT(a)\n"
+                  "INPUT(b)  # trailing comment\n"
+                  "OUTPUT(y)\n"
+                  "\n"
+                  "c = AND(a, \\\n"
+                  "        b)\n"
+                  "d = DFF(y)\n"
+                  "e = c\n"
+                  "f = LUT 0x8 (a, vdd)\n"
+                  "y = OR(e, d, f, gnd)\n",
+                  net, errors));
+  CHECK(errors.empty());
+  CHECK(net.getNodeCount() == 9);
+  for (Net::Id id = 0; id < net.getNodeCount(); id++) {
+    if (net.getName(id) == "y") {
+      CHECK(net.getPredecessors(id).size() == 4);
+    }
+    if (net.getName(id) == "d") {
+      CHECK(net.isDff(id));
+    }
+  }
+}
+
+void testSyntaxErrors() {
+  Net net;
+  std::string errors;
+  // A backslash not ending the line is not a name
+  CHECK(!readBench("INPUT(a)\n\\ = NOT(a)\n", net, errors));
+  CHECK(hasError(errors, ":2: unexpected '\\'"));
+  CHECK(!readBench("INPUT(a)\nINPUT(b)\nc = AND(a, \\ b)\n", net, errors));
+  CHECK(hasError(errors, ":3: expected a gate input name"));
+  CHECK(!readBench("INPUT(a)\nb = NOT(a) \\ c\n", net, errors));
+  CHECK(hasError(errors, ":2: unexpected token after ')'"));
+
+  CHECK(!readBench("INPUT(a\n", net, errors));
+  CHECK(hasError(errors, ":1: expected '(<name>)'"));
+  CHECK(!readBench("WIRE(a)\n", net, errors));
+  CHECK(hasError(errors, ":1: expected INPUT or OUTPUT"));
+  CHECK(!readBench("INPUT(a)\nb = NOT(a\n", net, errors));
+  CHECK(hasError(errors, ":2: expected ',' or ')'"));
+  CHECK(!readBench("INPUT(a)\nINPUT(b)\nc = DFF(a, b)\n", net, errors));
+  CHECK(hasError(errors, ":3: DFF must have a single input"));
+}
+
+void testRedefinitions() {
+  Net net;
+  std::string errors;
+  CHECK(!readBench("INPUT(a)\nb = NOT(a)\nb = BUF(a)\n", net, errors));
+  CHECK(hasError(errors, ":3: signal 'b' is already driven"));
+  CHECK(!readBench("INPUT(a)\nINPUT(a)\n", net, errors));
+  CHECK(hasError(errors, ":2: signal 'a' is already driven"));
+  CHECK(!readBench("INPUT(a)\na = NOT(a)\n", net, errors));
+  CHECK(hasError(errors, ":2: signal 'a' is already driven"));
+  CHECK(!readBench("INPUT(a)\nb = DFF(a)\nb = a\n", net, errors));
+  CHECK(hasError(errors, ":3: signal 'b' is already driven"));
+
+  // Several outputs of the same signal are fine
+  CHECK(readBench("INPUT(a)\nOUTPUT(a)\nOUTPUT(a)\n", net, errors));
+}
+
+void testUnresolved() {
+  Net net;
+  std::string errors;
+  CHECK(!readBench("INPUT(a)\nb = AND(a, c)\n", net, errors));
+  CHECK(hasError(errors, "unresolved signal 'c'"));
+}
+
+// The files of a few megabytes are parsed in chunks on the worker threads,
+// a signal driven again in a later chunk is only found when they are merged
+void testChunks() {
+  std::string text = "INPUT(a)\n";
+  size_t line = 1;
+  size_t redefinedLine = 0;
+  while (text.size() < (size_t{12} << 20)) {
+    const std::string name = "g" + std::to_string(line);
+    text += name + " = NOT(a)\n";
+    line++;
+  }
+  Net net;
+  std::string errors;
+  CHECK(readBench(text, net, errors));
+  CHECK(net.getNodeCount() == line);
+
+  text += "g1 = BUF(a)\n";
+  redefinedLine = line + 1;
+  CHECK(!readBench(text, net, errors));
+  CHECK(hasError(errors, ":" + std::to_string(redefinedLine) + ": signal 'g1' is already driven"));
+}
+
+int main() {
+  WorkerPool::setThreadCount(4);
+  testValidNet();
+  testSyntaxErrors();
+  testRedefinitions();
+  testUnresolved();
+  testChunks();
+  return finishTest();
+}
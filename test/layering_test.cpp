@@ -0,0 +1,113 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "layout.h"
+#include "netfmt_bench.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#ifndef BENCH_DIR
+#error "BENCH_DIR must point to the test nets"
+#endif
+
+const char *const BenchNames[] = {"s27", "s298", "s1196", "s5378"};
+
+const Layering Layerings[] = {
+    Layering::ASAP, Layering::ALAP, Layering::NetworkSimplex, Layering::CoffmanGraham};
+
+const CycleBreaking CycleBreakings[] = {CycleBreaking::FAS, CycleBreaking::DFF};
+
+struct LayeringResult {
+  size_t nodeCount = 0;
+  size_t dummyCount = 0;
+  // The most real nodes in a layer
+  size_t maxWidth = 0;
+  std::vector<int> layers;
+  LayeringStats stats;
+};
+
+LayeringResult layOut(const char *benchName,
+                      Layering layering,
+                      CycleBreaking cycleBreaking,
+                      size_t maxLayerWidth = 0) {
+  const std::string filename = std::string(BENCH_DIR) + "/" + benchName + ".bench";
+  Net net;
+  LayeringResult result;
+  CHECK(readNetFromBenchFile(filename.c_str(), net));
+  result.nodeCount = net.getNodeCount();
+  result.stats = net.assignLayers(layering, cycleBreaking, maxLayerWidth);
+
+  std::vector<size_t> widths;
+  for (Net::Id id = 0; id < net.getNodeCount(); id++) {
+    const int layer = net.getLayer(id);
+    CHECK(layer >= 0);
+    result.layers.push_back(layer);
+    // The nodes of the net keep their ids, the dummies follow them
+    CHECK(net.isDummy(id) == (id >= result.nodeCount));
+    if (net.isDummy(id)) {
+      result.dummyCount++;
+      // A dummy continues a single edge
+      CHECK(net.getPredecessors(id).size() == 1);
+      CHECK(net.getSuccessors(id).size() == 1);
+    } else {
+      widths.resize(std::max<size_t>(widths.size(), layer + 1), 0);
+      result.maxWidth = std::max(result.maxWidth, ++widths[layer]);
+    }
+    // The long edges are split by the dummies, so every edge connects the
+    // neighbouring layers in either direction. The edges broken by the cycle
+    // breaking are not layered and may connect the nodes of a layer
+    for (Net::Id succ : std::as_const(net).getSuccessors(id)) {
+      CHECK(std::abs(net.getLayer(succ) - layer) <= 1);
+    }
+  }
+  CHECK(result.stats.dummyCount == result.dummyCount);
+  return result;
+}
+
+void testLayerings() {
+  for (const char *benchName : BenchNames) {
+    for (CycleBreaking cycleBreaking : CycleBreakings) {
+      const LayeringResult asap = layOut(benchName, Layering::ASAP, cycleBreaking);
+      for (Layering layering : Layerings) {
+        const LayeringResult result = layOut(benchName, layering, cycleBreaking);
+        // The layering does not depend on anything but the net
+        CHECK(result.layers == layOut(benchName, layering, cycleBreaking).layers);
+
+        if (layering == Layering::NetworkSimplex) {
+          // The longest path layering is feasible, so the minimum total edge
+          // span cannot need more dummies
+          CHECK(result.dummyCount <= asap.dummyCount);
+          // The pivots only reduce the total edge span
+          CHECK(result.dummyCount <= result.stats.initialDummyCount);
+        }
+        if (layering == Layering::CoffmanGraham) {
+          const size_t maxWidth = std::ceil(std::sqrt(double(result.nodeCount)));
+          CHECK(result.maxWidth <= maxWidth);
+        }
+      }
+    }
+  }
+}
+
+void testCoffmanGrahamWidth() {
+  for (size_t maxWidth : {1, 2, 5}) {
+    const LayeringResult result =
+        layOut("s298", Layering::CoffmanGraham, CycleBreaking::FAS, maxWidth);
+    CHECK(result.maxWidth <= maxWidth);
+  }
+}
+
+int main() {
+  testLayerings();
+  testCoffmanGrahamWidth();
+  return finishTest();
+}
@@ -0,0 +1,146 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "layout.h"
+#include "layout_cache.h"
+#include "netfmt_bench.h"
+#include "test_util.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+const char *const Bench =
+    "INPUT(a)\n"
+    "INPUT(b)\n"
+    "OUTPUT(y)\n"
+    "c = AND(a, b)\n"
+    "d = DFF(y)\n"
+    "y = OR(c, d)\n";
+
+bool layOut(const std::string &filename,
+            Net &net,
+            std::vector<NormalizedElement> &elements) {
+  if (!readNetFromBenchFile(filename.c_str(), net)) {
+    return false;
+  }
+  net.assignLayers();
+  net.netTreeNodesToNormalizedElements(elements);
+  return true;
+}
+
+void testKeys() {
+  const std::string filename = writeTempFile(Bench);
+  const std::string otherFilename = writeTempFile(std::string(Bench) + "z = NOT(a)\n");
+  std::string key;
+  std::string sameKey;
+  std::string otherKey;
+  CHECK(LayoutCache::makeKey(filename.c_str(), "layering=asap", key));
+  CHECK(LayoutCache::makeKey(filename.c_str(), "layering=asap", sameKey));
+  CHECK(key == sameKey);
+  CHECK(key.size() == 16);
+
+  // Both the parameters and the input are hashed
+  CHECK(LayoutCache::makeKey(filename.c_str(), "layering=alap", otherKey));
+  CHECK(key != otherKey);
+  CHECK(LayoutCache::makeKey(otherFilename.c_str(), "layering=asap", otherKey));
+  CHECK(key != otherKey);
+
+  CHECK(!LayoutCache::makeKey("/nonexistent/net.bench", "layering=asap", key));
+  fs::remove(filename);
+  fs::remove(otherFilename);
+}
+
+void testHitAndMiss() {
+  const fs::path directory =
+      fs::temp_directory_path() / ("lsvis_cache_test_" + std::to_string(getpid()));
+  fs::remove_all(directory);
+  const std::string filename = writeTempFile(Bench);
+
+  Net net;
+  std::vector<NormalizedElement> elements;
+  CHECK(layOut(filename, net, elements));
+  std::string key;
+  CHECK(LayoutCache::makeKey(filename.c_str(), "layering=asap", key));
+
+  LayoutCache cache(directory, LayoutCache::DefaultMaxSize);
+  Net cachedNet;
+  std::vector<NormalizedElement> cachedElements;
+  CHECK(!cache.load(key, cachedNet, cachedElements));
+
+  CHECK(cache.store(key, net, elements));
+  CHECK(cache.load(key, cachedNet, cachedElements));
+  CHECK(cachedNet.getNodeCount() == net.getNodeCount());
+  CHECK(cachedElements.size() == elements.size());
+  for (Net::Id id = 0; id < net.getNodeCount(); id++) {
+    CHECK(cachedNet.getLayer(id) == net.getLayer(id));
+    CHECK(cachedNet.getNumber(id) == net.getNumber(id));
+  }
+
+  // Another key misses, a cleared cache misses
+  Net otherNet;
+  std::vector<NormalizedElement> otherElements;
+  CHECK(!cache.load(std::string(16, '0'), otherNet, otherElements));
+  cache.clear();
+  CHECK(!cache.load(key, otherNet, otherElements));
+
+  // A cache without space keeps nothing
+  LayoutCache emptyCache(directory, 0);
+  CHECK(emptyCache.store(key, net, elements));
+  CHECK(!emptyCache.load(key, otherNet, otherElements));
+
+  fs::remove_all(directory);
+  fs::remove(filename);
+}
+
+// The temporary files left behind by the interrupted runs are swept
+void testTemporaryFiles() {
+  const fs::path directory =
+      fs::temp_directory_path() / ("lsvis_cache_tmp_test_" + std::to_string(getpid()));
+  fs::remove_all(directory);
+  fs::create_directories(directory);
+  const std::string filename = writeTempFile(Bench);
+
+  Net net;
+  std::vector<NormalizedElement> elements;
+  CHECK(layOut(filename, net, elements));
+  std::string key;
+  CHECK(LayoutCache::makeKey(filename.c_str(), "layering=asap", key));
+
+  const fs::path stalePath = directory / (key + ".lsvsnap.1.tmp");
+  const fs::path freshPath = directory / (key + ".lsvsnap.2.tmp");
+  std::ofstream(stalePath) << "stale";
+  std::ofstream(freshPath) << "fresh";
+  fs::last_write_time(stalePath,
+                      fs::file_time_type::clock::now() - std::chrono::hours(2));
+
+  // Storing an entry only removes the old temporary files, the others may
+  // still be written
+  LayoutCache cache(directory, LayoutCache::DefaultMaxSize);
+  CHECK(cache.store(key, net, elements));
+  CHECK(!fs::exists(stalePath));
+  CHECK(fs::exists(freshPath));
+
+  cache.clear();
+  CHECK(!fs::exists(freshPath));
+  CHECK(fs::is_empty(directory));
+
+  fs::remove_all(directory);
+  fs::remove(filename);
+}
+
+int main() {
+  testKeys();
+  testHitAndMiss();
+  testTemporaryFiles();
+  return finishTest();
+}
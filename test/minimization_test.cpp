@@ -0,0 +1,114 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "layout.h"
+#include "minimization.h"
+#include "netfmt_bench.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef BENCH_DIR
+#error "BENCH_DIR must point to the test nets"
+#endif
+
+// Checking every pair of the edges between the same layers. The nets have
+// no edges within a layer
+int64_t countIntersectionsBruteForce(const Net &net) {
+  // The upper and the lower end of every edge
+  std::vector<std::pair<Net::Id, Net::Id>> edges;
+  for (Net::Id id = 0; id < net.getNodeCount(); id++) {
+    for (Net::Id succ : net.getSuccessors(id)) {
+      CHECK(net.getLayer(succ) != net.getLayer(id));
+      if (net.getLayer(succ) > net.getLayer(id)) {
+        edges.emplace_back(id, succ);
+      } else {
+        edges.emplace_back(succ, id);
+      }
+    }
+  }
+  int64_t count = 0;
+  for (size_t i = 0; i < edges.size(); i++) {
+    for (size_t j = i + 1; j < edges.size(); j++) {
+      const auto [upper, lower] = edges[i];
+      const auto [otherUpper, otherLower] = edges[j];
+      if (net.getLayer(upper) != net.getLayer(otherUpper)) {
+        continue;
+      }
+      const int upperOrder = net.getNumber(upper) - net.getNumber(otherUpper);
+      const int lowerOrder = net.getNumber(lower) - net.getNumber(otherLower);
+      count += (upperOrder < 0 && lowerOrder > 0) || (upperOrder > 0 && lowerOrder < 0);
+    }
+  }
+  return count;
+}
+
+// Shuffling the nodes within their layers
+void shuffleNumbers(Net &net, std::mt19937_64 &generator) {
+  std::vector<std::vector<Net::Id>> layers;
+  for (Net::Id id = 0; id < net.getNodeCount(); id++) {
+    layers.resize(std::max<size_t>(layers.size(), net.getLayer(id) + 1));
+    layers[net.getLayer(id)].push_back(id);
+  }
+  for (std::vector<Net::Id> &layer : layers) {
+    std::shuffle(layer.begin(), layer.end(), generator);
+    for (size_t i = 0; i < layer.size(); i++) {
+      net.setNumber(layer[i], i);
+    }
+  }
+}
+
+void testCountingOnRandomNets() {
+  std::mt19937_64 generator(1);
+  for (int attempt = 0; attempt < 20; attempt++) {
+    // A random DAG, the edges go from the lower ids to the higher ones
+    Net net;
+    const Net::Id nodeCount = 10 + generator() % 60;
+    for (Net::Id id = 0; id < nodeCount; id++) {
+      net.addNode("n" + std::to_string(id));
+    }
+    for (Net::Id id = 1; id < nodeCount; id++) {
+      const size_t predCount = 1 + generator() % 3;
+      for (size_t k = 0; k < predCount; k++) {
+        net.linkNodes(generator() % id, id);
+      }
+    }
+    net.buildAdjacency();
+    net.assignLayers();
+    for (int order = 0; order < 5; order++) {
+      shuffleNumbers(net, generator);
+      CHECK(countIntersections(net) == countIntersectionsBruteForce(net));
+    }
+  }
+}
+
+void testCountingOnBenchNets() {
+  std::mt19937_64 generator(2);
+  for (const char *benchName : {"s27", "s298", "s386"}) {
+    const std::string filename = std::string(BENCH_DIR) + "/" + benchName + ".bench";
+    Net net;
+    CHECK(readNetFromBenchFile(filename.c_str(), net));
+    net.assignLayers(Layering::NetworkSimplex);
+    CHECK(countIntersections(net) == countIntersectionsBruteForce(net));
+    minimizeIntersections(net);
+    CHECK(countIntersections(net) == countIntersectionsBruteForce(net));
+    shuffleNumbers(net, generator);
+    CHECK(countIntersections(net) == countIntersectionsBruteForce(net));
+  }
+}
+
+int main() {
+  testCountingOnRandomNets();
+  testCountingOnBenchNets();
+  return finishTest();
+}
@@ -0,0 +1,71 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "parallel.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+constexpr unsigned ThreadCount = 4;
+constexpr size_t RunCount = 8;
+
+// Every job must be joined by the workers, not only the first one. The
+// tasks sleep, so that the calling thread cannot finish them alone
+void testWorkersJoinEveryJob() {
+  WorkerPool &pool = WorkerPool::get();
+  CHECK(pool.getThreadCount() == ThreadCount);
+  for (size_t run = 0; run < RunCount; run++) {
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    std::vector<int> done(4 * ThreadCount, 0);
+    pool.run(done.size(), [&](size_t i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      std::lock_guard<std::mutex> lock(mutex);
+      threads.insert(std::this_thread::get_id());
+      done[i]++;
+    });
+    CHECK(threads.size() > 1);
+    CHECK(std::count(done.begin(), done.end(), 1) == int(done.size()));
+  }
+}
+
+void testParallelFor() {
+  std::vector<int> visits(100000, 0);
+  parallelFor(visits.size(), 1000, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      visits[i]++;
+    }
+  });
+  CHECK(std::count(visits.begin(), visits.end(), 1) == int(visits.size()));
+}
+
+void testParallelSort() {
+  std::vector<unsigned> values(100000);
+  unsigned value = 1;
+  for (unsigned &v : values) {
+    value = value * 1103515245u + 12345u;
+    v = value;
+  }
+  std::vector<unsigned> expected = values;
+  std::sort(expected.begin(), expected.end());
+  parallelSort(values.begin(), values.end(), 1000, std::less<unsigned>());
+  CHECK(values == expected);
+}
+
+int main() {
+  WorkerPool::setThreadCount(ThreadCount);
+  testWorkersJoinEveryJob();
+  testParallelFor();
+  testParallelSort();
+  return finishTest();
+}
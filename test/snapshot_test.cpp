@@ -0,0 +1,192 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#include "layout.h"
+#include "minimization.h"
+#include "netfmt_bench.h"
+#include "snapshot.h"
+#include "test_util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef BENCH_DIR
+#error "BENCH_DIR must point to the test nets"
+#endif
+
+bool isSameNet(const Net &lhs, const Net &rhs) {
+  if (lhs.getNodeCount() != rhs.getNodeCount()) {
+    return false;
+  }
+  for (Net::Id id = 0; id < lhs.getNodeCount(); id++) {
+    const Span<const Net::Id> lhsSucc = lhs.getSuccessors(id);
+    const Span<const Net::Id> rhsSucc = rhs.getSuccessors(id);
+    const Span<const Net::Id> lhsPred = lhs.getPredecessors(id);
+    const Span<const Net::Id> rhsPred = rhs.getPredecessors(id);
+    if (lhs.getName(id) != rhs.getName(id) ||
+        lhs.getLayer(id) != rhs.getLayer(id) ||
+        lhs.getNumber(id) != rhs.getNumber(id) ||
+        lhs.isDummy(id) != rhs.isDummy(id) ||
+        lhs.isDff(id) != rhs.isDff(id) ||
+        !std::equal(lhsSucc.begin(), lhsSucc.end(), rhsSucc.begin(), rhsSucc.end()) ||
+        !std::equal(lhsPred.begin(), lhsPred.end(), rhsPred.begin(), rhsPred.end())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool isSamePoint(const NormalizedPoint &lhs, const NormalizedPoint &rhs) {
+  return lhs.nX == rhs.nX && lhs.nY == rhs.nY;
+}
+
+bool isSameElements(const std::vector<NormalizedElement> &lhs,
+                    const std::vector<NormalizedElement> &rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs.size(); i++) {
+    if (lhs[i].id != rhs[i].id || !isSamePoint(lhs[i].nPoint, rhs[i].nPoint) ||
+        lhs[i].nW != rhs[i].nW || lhs[i].nH != rhs[i].nH ||
+        lhs[i].connections.size() != rhs[i].connections.size()) {
+      return false;
+    }
+    for (size_t j = 0; j < lhs[i].connections.size(); j++) {
+      const NormalizedConnection &lhsConnection = lhs[i].connections[j];
+      const NormalizedConnection &rhsConnection = rhs[i].connections[j];
+      if (lhsConnection.id != rhsConnection.id ||
+          lhsConnection.startElementId != rhsConnection.startElementId ||
+          lhsConnection.endElementId != rhsConnection.endElementId ||
+          !std::equal(lhsConnection.nVertices.begin(), lhsConnection.nVertices.end(),
+                      rhsConnection.nVertices.begin(), rhsConnection.nVertices.end(),
+                      isSamePoint)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void testRoundTrip() {
+  const std::string benchFilename = std::string(BENCH_DIR) + "/s298.bench";
+  Net net;
+  std::vector<NormalizedElement> elements;
+  CHECK(readNetFromBenchFile(benchFilename.c_str(), net));
+  net.assignLayers(Layering::ASAP, CycleBreaking::DFF);
+  minimizeIntersections(net);
+  net.netTreeNodesToNormalizedElements(elements);
+
+  const std::string filename = writeTempFile("", ".lsvis");
+  CHECK(saveSnapshot(filename.c_str(), net, elements));
+  CHECK(isSnapshotFile(filename.c_str()));
+  CHECK(!isSnapshotFile(benchFilename.c_str()));
+
+  Net loadedNet;
+  std::vector<NormalizedElement> loadedElements;
+  CHECK(loadSnapshot(filename.c_str(), loadedNet, loadedElements));
+  CHECK(isSameNet(net, loadedNet));
+  CHECK(isSameElements(elements, loadedElements));
+  std::remove(filename.c_str());
+}
+
+// The damaged snapshots are rejected instead of being read
+void testDamagedSnapshots() {
+  Net net;
+  std::vector<NormalizedElement> elements;
+  const std::string benchFilename = std::string(BENCH_DIR) + "/s27.bench";
+  CHECK(readNetFromBenchFile(benchFilename.c_str(), net));
+  net.assignLayers();
+  net.netTreeNodesToNormalizedElements(elements);
+  const std::string filename = writeTempFile("", ".lsvis");
+  CHECK(saveSnapshot(filename.c_str(), net, elements));
+
+  std::ifstream in(filename, std::ios::binary);
+  const std::string data((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+  const std::string truncatedFilename = writeTempFile(data.substr(0, data.size() / 2), ".lsvis");
+  std::string otherVersion = data;
+  // The version follows the 8-byte signature
+  otherVersion[8] ^= 0x7f;
+  const std::string otherVersionFilename = writeTempFile(otherVersion, ".lsvis");
+
+  std::ostringstream errors;
+  std::streambuf *cerrBuffer = std::cerr.rdbuf(errors.rdbuf());
+  Net loadedNet;
+  std::vector<NormalizedElement> loadedElements;
+  CHECK(!loadSnapshot(truncatedFilename.c_str(), loadedNet, loadedElements));
+  Net otherNet;
+  CHECK(!loadSnapshot(otherVersionFilename.c_str(), otherNet, loadedElements));
+  std::cerr.rdbuf(cerrBuffer);
+
+  std::remove(filename.c_str());
+  std::remove(truncatedFilename.c_str());
+  std::remove(otherVersionFilename.c_str());
+}
+
+// Overwriting a 64-bit field of the snapshot header
+void setHeaderField(std::string &data, size_t offset, uint64_t value) {
+  std::memcpy(&data[offset], &value, sizeof(value));
+}
+
+// A count that overflows when the offset arrays get their extra entry. The
+// matching offset section is emptied, so that only the count can reject it
+void testCorruptedCounts() {
+  Net net;
+  std::vector<NormalizedElement> elements;
+  const std::string benchFilename = std::string(BENCH_DIR) + "/s27.bench";
+  CHECK(readNetFromBenchFile(benchFilename.c_str(), net));
+  net.assignLayers();
+  net.netTreeNodesToNormalizedElements(elements);
+  const std::string filename = writeTempFile("", ".lsvis");
+  CHECK(saveSnapshot(filename.c_str(), net, elements));
+
+  std::ifstream in(filename, std::ios::binary);
+  const std::string data((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+  std::remove(filename.c_str());
+
+  // The counts follow the signature, the version and the byte order mark,
+  // the offset and the size of every section follow the counts
+  const size_t countsOffset = 16;
+  const size_t sectionsOffset = countsOffset + 5 * sizeof(uint64_t);
+  // The node, name, element and connection counts with the sections of
+  // the succ, name, connection and vertex offsets
+  const std::pair<size_t, size_t> countSections[] = {{0, 0}, {1, 8}, {2, 11}, {3, 13}};
+  for (const auto &[count, section] : countSections) {
+    std::string corrupted = data;
+    setHeaderField(corrupted, countsOffset + count * sizeof(uint64_t), UINT64_MAX);
+    setHeaderField(corrupted, sectionsOffset + section * 2 * sizeof(uint64_t) +
+                   sizeof(uint64_t), 0);
+    const std::string corruptedFilename = writeTempFile(corrupted, ".lsvis");
+
+    std::ostringstream errors;
+    std::streambuf *cerrBuffer = std::cerr.rdbuf(errors.rdbuf());
+    Net loadedNet;
+    std::vector<NormalizedElement> loadedElements;
+    CHECK(!loadSnapshot(corruptedFilename.c_str(), loadedNet, loadedElements));
+    std::cerr.rdbuf(cerrBuffer);
+    CHECK(errors.str().find("corrupted") != std::string::npos);
+    std::remove(corruptedFilename.c_str());
+  }
+}
+
+int main() {
+  testRoundTrip();
+  testDamagedSnapshots();
+  testCorruptedCounts();
+  return finishTest();
+}
@@ -0,0 +1,48 @@
+//===----------------------------------------------------------------------===//
+//
+// Part of the Utopia EDA Project, under the Apache License v2.0
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2023 ISP RAS (http://www.ispras.ru)
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TEST_UTIL_H_
+#define TEST_UTIL_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+// The number of the failed checks, the test fails if it is not zero
+inline int failedChecks = 0;
+
+#define CHECK(condition)                                                     \
+  do {                                                                       \
+    if (!(condition)) {                                                      \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                   #condition);                                              \
+      failedChecks++;                                                        \
+    }                                                                        \
+  } while (false)
+
+inline int finishTest() {
+  if (failedChecks != 0) {
+    std::fprintf(stderr, "%d checks failed\n", failedChecks);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+// Writing the text into a new temporary file, the name is returned
+inline std::string writeTempFile(const std::string &text,
+                                 const char *suffix = ".bench") {
+  std::string name = "/tmp/lsvis_test_" + std::to_string(getpid()) + "_" +
+                     std::to_string(std::rand()) + suffix;
+  std::ofstream out(name, std::ios::binary);
+  out << text;
+  return name;
+}
+
+#endif // TEST_UTIL_H_